@@ -206,6 +206,49 @@ int OpenFile::WriteAt(char *from, int numBytes, int position)
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadSectors/WriteSectors
+// 	Read/write the whole sectors holding "numBytes" bytes of the file
+//	starting at "position", both multiples of SectorSize, straight to
+//	or from memory: each one is found with the file header's
+//	ByteToSector and transferred on its own, with no buffer to copy
+//	through.  Used to page memory-mapped files in and out.
+//
+//	The file never grows.  ReadSectors fills whatever lies past the
+//	end of the file with zeroes; WriteSectors drops it.  Both return
+//	the number of bytes of the file actually read/written.
+//----------------------------------------------------------------------
+
+int OpenFile::ReadSectors(char *into, int numBytes, int position)
+{
+    int numRead = max(0, min(numBytes, hdr->FileLength() - position));
+
+    ASSERT(position % SectorSize == 0 && numBytes % SectorSize == 0);
+    for (int i = 0; i < numRead; i += SectorSize)
+        synchDisk->ReadSector(hdr->ByteToSector(position + i), &into[i]);
+    bzero(&into[numRead], numBytes - numRead);  // past the end, and the
+                                                // rest of the last sector
+    hdr->setVisitTime(getCurrentTime());
+    return numRead;
+}
+
+int OpenFile::WriteSectors(char *from, int numBytes, int position)
+{
+    int fileLength = hdr->FileLength();
+    char *currentTime;
+
+    ASSERT(position % SectorSize == 0 && numBytes % SectorSize == 0);
+    if (position >= fileLength)
+        return 0;
+    numBytes = min(numBytes, fileLength - position);
+    for (int i = 0; i < numBytes; i += SectorSize)
+        synchDisk->WriteSector(hdr->ByteToSector(position + i), &from[i]);
+    currentTime = getCurrentTime();
+    hdr->setVisitTime(currentTime);
+    hdr->setModifyTime(currentTime);
+    return numBytes;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -215,3 +258,14 @@ int OpenFile::Length()
 {
     return hdr->FileLength();
 }
+
+//----------------------------------------------------------------------
+// OpenFile::HeaderSector
+// 	Return the sector holding the file's header, which names the file
+//	on disk.
+//----------------------------------------------------------------------
+
+int OpenFile::HeaderSector()
+{
+    return hdr->getHeaderSector();
+}
@@ -50,8 +50,25 @@ class OpenFile {
 		currentOffset += numWritten;
 		return numWritten;
 		}
+    int ReadSectors(char *into, int numBytes, int position) {
+		int numRead = ReadAt(into, numBytes, position);
+		if (numRead < 0)
+		    numRead = 0;
+		for (int i = numRead; i < numBytes; i++)
+		    into[i] = 0;
+		return numRead;
+		}
+    int WriteSectors(char *from, int numBytes, int position) {
+		int length = Length();
+		if (position >= length)
+		    return 0;
+		return WriteAt(from, min(numBytes, length - position),
+				position);
+		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+    int HeaderSector() { return FileNumber(file); }	// the UNIX file's
+							// inode # will do
     
   private:
     int file;
@@ -81,10 +98,22 @@ class OpenFile {
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
 
+    int ReadSectors(char *into, int numBytes, int position);
+					// Read/write whole sectors, straight
+					// to/from "into"/"from", without
+					// copying them through a buffer; for
+					// memory-mapped files.  The file
+					// doesn't grow, and reads past its
+					// end return zeroes
+    int WriteSectors(char *from, int numBytes, int position);
+
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    int HeaderSector();			// Return the sector holding the
+					// file header, which no other file
+					// has
     
   private:
     FileHeader *hdr;			// Header for this file 
@@ -146,20 +146,25 @@ Interrupt::Enable()
 //
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
-//		a user instruction is executed
+//		a user instruction (or a batch of them) is executed
+//
+//	"numTicks" -- how many ticks to advance; when a batch of user
+//		instructions has been run, this is the number of
+//		instructions in it.  The batch must end no later than
+//		NextDue(), so no interrupt is taken late.
 //----------------------------------------------------------------------
 void
-Interrupt::OneTick()
+Interrupt::OneTick(int numTicks)
 {
     MachineStatus old = status;
 
 // advance simulated time
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
-	stats->systemTicks += SystemTick;
+        stats->totalTicks += SystemTick * numTicks;
+	stats->systemTicks += SystemTick * numTicks;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->totalTicks += UserTick * numTicks;
+	stats->userTicks += UserTick * numTicks;
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
@@ -179,6 +184,26 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::NextDue
+// 	Return the simulated time at which the earliest pending interrupt
+//	is scheduled to occur, or -1 if no interrupts are pending.
+//
+//	Until then, OneTick would find nothing to do, so Machine::Run
+//	can execute user instructions up to this time and charge for
+//	them with a single OneTick.
+//----------------------------------------------------------------------
+
+int
+Interrupt::NextDue()
+{
+    int when;
+
+    if (pending->Head(&when) == NULL)
+	return -1;
+    return when;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -204,6 +229,8 @@ Interrupt::YieldOnReturn()
 //	Since something has to be running in order to put a thread
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
+//	With user programs, the time is put to use first, zeroing free
+//	page frames for later page faults (see userprog/coremap.h).
 //
 //	If there are no pending interrupts, stop.  There's nothing
 //	more for us to do.
@@ -213,6 +240,11 @@ Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+#ifdef USER_PROGRAM
+    if (coreMap != NULL)
+	while (coreMap->ZeroFreeFrame())
+	    ;
+#endif
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
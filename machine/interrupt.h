@@ -110,7 +110,12 @@ class Interrupt {
 	int arg, int when, IntType type);// at time ``when''.  This is called
     					// by the hardware device simulators.
     
-    void OneTick();       		// Advance simulated time
+    void OneTick(int numTicks = 1);	// Advance simulated time, by
+					// one tick or by the time taken
+					// by a batch of user instructions
+
+    int NextDue();			// When the next pending interrupt
+					// is to occur, or -1 if none is
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
@@ -13,6 +13,14 @@
 #include <stdio.h>
 
 #define USE_TLB0
+
+// The size of the simulated machine; Initialize may change these before
+// the Machine is created, but they must not change after that.
+int PageSize = DefaultPageSize;
+int NumPhysPages = DefaultNumPhysPages;
+int TLBSize = DefaultTLBSize;
+int TLBWays = DefaultTLBWays;
+
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
 static char* exceptionNames[] = { "no exception", "syscall", 
@@ -60,25 +68,61 @@ Machine::Machine(bool debug)
 
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
+    ASSERT((NumPhysPages > 0) && (TLBSize > 0));
+    ASSERT((PageSize >= 8) && ((PageSize & (PageSize - 1)) == 0));
+    for (pageShift = 0; (1 << pageShift) < PageSize; pageShift++)
+	;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-    bitmap = new Bitmap;
+    decodeCache = new Instruction[MemorySize / 4];
+    decodeValid = new bool[MemorySize / 4];
+    blockLength = new int[MemorySize / 4];
+    superOp = new char[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+	decodeValid[i] = FALSE;
+	blockLength[i] = -1;
+    }
+    frameDecoded = new bool[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+	frameDecoded[i] = FALSE;
     end = 0;
-    // pageTable在AddrSpace::RestoreState中赋值
+    pageTable = new InvertedPageTable(NumPhysPages);
+    currentSpace = -1;		// set by AddrSpace::RestoreState
+    currentASID = -1;
+    pageTableSize = 0;
 #ifdef USE_TLB
     //printf("TLB OK\n");
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	    tlb[i].valid = FALSE;
-    pageTable = NULL;
-    TLBhit = 0;
-    TLBmiss = 0;
-#else	// use linear page table
+    if (TLBWays <= 0 || TLBWays > TLBSize)
+	TLBWays = TLBSize;		// fully associative
+    ASSERT(TLBSize % TLBWays == 0);
+    numTLBSets = TLBSize / TLBWays;
+    numTLBEntries = (TLBWays == 1) ? TLBSize + 1 : TLBSize;
+    tlb = new TranslationEntry[numTLBEntries];
+    tlbOlder = new int[TLBSize];
+    tlbNewer = new int[TLBSize];
+    tlbMostRecent = new int[numTLBSets];
+    for (i = 0; i < numTLBEntries; i++)
+	tlb[i].valid = FALSE;
+    for (i = 0; i < TLBSize; i++) {
+	int first = i - i % TLBWays;	// start of its set
+	tlbOlder[i] = first + (i - first + 1) % TLBWays;
+	tlbNewer[i] = first + (i - first + TLBWays - 1) % TLBWays;
+    }
+    for (i = 0; i < numTLBSets; i++)
+	tlbMostRecent[i] = i * TLBWays;
+    stats->tlbSize = TLBSize;
+    stats->tlbWays = TLBWays;
+#else	// use the inverted page table directly
     tlb = NULL;
-    pageTable = NULL;
+    tlbOlder = tlbNewer = tlbMostRecent = NULL;
+    numTLBSets = numTLBEntries = 0;
 #endif
 
+    FlushHostTLB();
+    lastTLBEntry = -1;
+    pendingTicks = 0;
+
     singleStep = debug;
     CheckEndian();
 }
@@ -91,8 +135,18 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    delete [] decodeCache;
+    delete [] decodeValid;
+    delete [] blockLength;
+    delete [] superOp;
+    delete [] frameDecoded;
+    delete pageTable;
+    if (tlb != NULL) {
         delete [] tlb;
+        delete [] tlbOlder;
+        delete [] tlbNewer;
+        delete [] tlbMostRecent;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -113,6 +167,14 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+
+    // Charge for the user instructions already run in this batch, so the
+    // kernel sees the right time.  No interrupt can be due yet (the batch
+    // ends before one is), so there is nothing to check for.
+    stats->totalTicks += pendingTicks * UserTick;
+    stats->userTicks += pendingTicks * UserTick;
+    pendingTicks = 0;
+
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     interrupt->setStatus(UserMode);
@@ -219,30 +281,3 @@ void Machine::WriteRegister(int num, int value)
 	// DEBUG('m', "WriteRegister %d, value %d\n", num, value);
 	registers[num] = value;
     }
-
-Bitmap::Bitmap() {
-    for (int i = 0; i < NumPhysPages; i++) {
-        map[i] = 0;
-    }
-}
-
-int Bitmap::find() {
-    int out = -1;
-    for (int i = 0; i < NumPhysPages; i++) {
-        if (map[i] == 0) {
-            out = i;
-            break;
-        }
-    }
-    if (out == -1)
-        return out;
-    map[out] = 1;
-    DEBUG('M', "Page %d is allocated\n", out);
-    return out;
-}
-
-void Bitmap::clear(int idx) {
-    ASSERT(map[idx] == 1);
-    DEBUG('M', "Page %d is cleared\n", idx);
-    map[idx] = 0;
-}
\ No newline at end of file
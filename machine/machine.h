@@ -28,13 +28,24 @@
 
 // Definitions related to the size, and format of user memory
 
-#define PageSize SectorSize // set the page size equal to
-							// the disk sector size, for
-							// simplicity
-
-#define NumPhysPages 64
+// The size of the machine is chosen when Nachos starts up (see the -mem,
+// -pgsz, -tlb and -tlbways flags in system.cc), before the Machine is
+// created.
+
+#define DefaultPageSize 128		// bytes per page; must be a power of two
+#define DefaultNumPhysPages 64	// # of physical page frames
+#define DefaultTLBSize 4		// if there is a TLB, make it small
+#define DefaultTLBWays 0		// and fully associative
+
+extern int PageSize;
+extern int NumPhysPages;
+extern int TLBSize;
+extern int TLBWays;			// entries per TLB set; 0 means all of
+					// them (1 is direct-mapped)
 #define MemorySize (NumPhysPages * PageSize)
-#define TLBSize 4 // if there is a TLB, make it small
+#define HostTLBSize 32 // entries in the host translation cache
+					   // (a power of two)
+#define NumASIDs 64 // address space identifiers that can tag TLB entries
 
 enum ExceptionType
 {
@@ -94,13 +105,20 @@ public:
 					 // Immediates are sign-extended.
 };
 
-class Bitmap
+// An entry of the simulator's host translation cache: a virtual page that
+// Translate has already checked, and where it lives in mainMemory.
+// ReadMem, WriteMem and instruction fetch look here before walking the page
+// table or TLB.  An entry only lets stores through once a store has been
+// translated for the page, so the use and dirty bits stay exact.
+
+class HostTranslation
 {
 public:
-	Bitmap();
-	int find();
-	void clear(int idx);
-	int map[NumPhysPages];
+	unsigned int virtualPage; // the page cached here, or -1 if empty
+	char *page;				  // the start of the page in mainMemory
+	bool writable;			  // may stores skip Translate?
+	int tlbEntry;			  // TLB slot the page was found in, or -1
+							  // when translating through the page table
 };
 
 // The following class defines the simulated host workstation hardware, as
@@ -135,15 +153,39 @@ public:
 
 	void OneInstruction(Instruction *instr);
 	// Run one instruction of a user program.
+	bool OneBlock(int budget);
+	// Run a straight-line basic block of a user
+	// program, at most "budget" instructions of
+	// it; return FALSE if one raised an exception
+	bool ExecuteInstruction(Instruction *instr);
+	// Carry out one decoded instruction; return
+	// FALSE if it raised an exception
 	void DelayedLoad(int nextReg, int nextVal);
 	// Do a pending delayed load (modifying a reg)
 
+	void InvalidateDecodeCache(int frame);
+	// Discard the predecoded instructions of a
+	// physical page, because its contents are
+	// about to change (or just did)
+
 	bool ReadMem(int addr, int size, int *value);
 	bool WriteMem(int addr, int size, int value);
 	// Read or write 1, 2, or 4 bytes of virtual
 	// memory (at addr).  Return FALSE if a
 	// correct translation couldn't be found.
 
+	bool CopyIn(int virtAddr, char *buffer, int size);
+	bool CopyOut(int virtAddr, char *buffer, int size);
+	// Copy "size" bytes between virtual memory
+	// (at virtAddr) and a kernel buffer, a page
+	// at a time, paging in as needed.  Return
+	// FALSE on a bad address.
+	int CopyInString(int virtAddr, char *buffer, int size);
+	// Copy in a null-terminated string of at
+	// most "size" bytes, counting the null.
+	// Return its length, or -1 if it is too
+	// long or at a bad address.
+
 	ExceptionType Translate(int virtAddr, int *physAddr, int size, bool writing);
 	// Translate an address, and check for
 	// alignment.  Set the use and dirty bits in
@@ -151,6 +193,17 @@ public:
 	// and return an exception code if the
 	// translation couldn't be completed.
 
+	void FlushHostTLB();
+	// Forget all cached host translations.
+	// The kernel must call this whenever it
+	// changes the page table or the TLB.
+
+	int TLBVictim(int vpn);
+	// The TLB slot to load a translation of
+	// page "vpn" into: an empty one of the
+	// set the page maps to, or else the least
+	// recently used one
+
 	void RaiseException(ExceptionType which, int badVAddr);
 	// Trap to the Nachos kernel, because of a
 	// system call or other exception.
@@ -171,32 +224,93 @@ public:
 	// NOTE: the hardware translation of virtual addresses in the user program
 	// to physical addresses (relative to the beginning of "mainMemory")
 	// can be controlled by one of:
-	//	a traditional linear page table
+	//	an inverted page table, shared by all address spaces and
+	//	  searched by hashing <address space #, virtual page #>
 	//  	a software-loaded translation lookaside buffer (tlb) -- a cache of
 	//	  mappings of virtual page #'s to physical page #'s
 	//
-	// If "tlb" is NULL, the linear page table is used
+	// If "tlb" is NULL, the inverted page table is used
 	// If "tlb" is non-NULL, the Nachos kernel is responsible for managing
 	//	the contents of the TLB.  But the kernel can use any data structure
 	//	it wants (eg, segmented paging) for handling TLB cache misses.
+	//	Ours refills the TLB from the same inverted page table.
 	//
 	// For simplicity, both the page table pointer and the TLB pointer are
-	// public.  However, while there can be multiple page tables (one per address
-	// space, stored in memory), there is only one TLB (implemented in hardware).
-	// Thus the TLB pointer should be considered as *read-only*, although
+	// public.  There is only one of each; the kernel tells the hardware
+	// which address space is running by setting "currentSpace", and,
+	// for the TLB, "currentASID": a TLB entry only matches if it is
+	// tagged with the running address space's identifier, so the
+	// entries of other address spaces can stay in the TLB across
+	// context switches.
+	//
+	// The TLB is set-associative: its TLBSize entries are split into
+	// sets of TLBWays entries, and virtual page "vpn" can only be cached
+	// in set vpn % numTLBSets, whose entries are tlb[set * TLBWays] up
+	// to tlb[(set + 1) * TLBWays - 1].  The hardware keeps each set in
+	// least recently used order for the kernel (see TLBVictim).
+	//
+	// An instruction may need two pages at once, its own and the one
+	// it loads or stores; if they map to the same set of a
+	// direct-mapped TLB, each would throw the other out, and the
+	// instruction would miss forever.  So a direct-mapped TLB has one
+	// more entry, tlb[TLBSize], that any page can go in: the kernel
+	// moves the entry it replaces in a set there.
+	// The TLB pointer should be considered as *read-only*, although
 	// the contents of the TLB are free to be modified by the kernel software.
 
 	TranslationEntry *tlb; // this pointer should be considered
 						   // "read-only" to Nachos kernel code
 
-	TranslationEntry *pageTable;
-	unsigned int pageTableSize;
-	int TLBhit;
-	int TLBmiss;
-	Bitmap *bitmap;
+	InvertedPageTable *pageTable; // every page in physical memory
+	int currentSpace;			  // address space # of the running program
+	int currentASID;			  // and the ASID its TLB entries carry
+	unsigned int pageTableSize;	  // # of virtual pages in that space
+	int numTLBSets;				  // # of sets the TLB is split into
+	int numTLBEntries;			  // TLBSize, plus the extra entry of
+								  // a direct-mapped TLB
 	int end;
 
 private:
+	Instruction *decodeCache; // predecoded instructions, one for every
+		// word of mainMemory, filled in the first
+		// time that word is executed
+	bool *decodeValid; // is the matching decodeCache entry filled in?
+	bool *frameDecoded; // does the physical page hold any filled
+		// decodeCache entries?
+	int *blockLength; // # of instructions in the translated basic
+		// block starting at each word of mainMemory,
+		// or -1 if it hasn't been translated yet
+	char *superOp; // superinstruction (SUPER_*) starting at
+		// each word of a translated block
+
+	Instruction *Predecoded(int physAddr); // decoded instruction at
+		// "physAddr", from decodeCache
+	void TranslateBlock(int physAddr); // find and predecode the basic
+		// block starting at "physAddr"
+
+	int pageShift; // log2(PageSize), to split addresses quickly
+
+	int pendingTicks; // # of user instructions run in the current
+		// batch, and not yet charged for
+
+	HostTranslation hostTLB[HostTLBSize]; // recently translated pages,
+		// indexed by virtual page # mod HostTLBSize
+	int lastTLBEntry; // TLB slot used by the last Translate,
+		// or -1 if it used the page table
+
+	ExceptionType CachedTranslate(int virtAddr, int *physAddr, int size,
+								  bool writing); // Translate, but check
+		// hostTLB first and remember the result
+	void TouchTLB(int entry); // record a hit on a TLB slot
+	int *tlbOlder; // for each TLB slot, the next less recently
+	int *tlbNewer; // used and more recently used one in its set;
+		// each set is a circular list, so the least recently
+		// used slot is the one "newer" than the most recent
+	int *tlbMostRecent; // the most recently used slot of each set
+	bool KernelTranslate(int virtAddr, int *physAddr, bool writing);
+		// translate an address for the kernel,
+		// handling any page fault right away
+
 	bool singleStep; // drop back into the debugger after each
 		// simulated instruction
 	int runUntilTime; // drop back into the debugger when simulated
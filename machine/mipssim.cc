@@ -18,6 +18,9 @@
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
+#define MaxBatch 100000		// most user instructions Run executes
+				// between calls to OneTick
+
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
@@ -31,8 +34,9 @@ void
 Machine::Run()
 {
     Instruction *instr = new Instruction;  // storage for decoded instruction
+    bool tracing = DebugIsEnabled('m');
 
-    if(DebugIsEnabled('m'))
+    if (tracing)
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
 
@@ -44,14 +48,56 @@ Machine::Run()
 			end = 0;
 			break;
 		}*/
-        OneInstruction(instr);
-		interrupt->OneTick();
-		if (singleStep && (runUntilTime <= stats->totalTicks))
-			Debugger();
+	if (singleStep || tracing) {	// one instruction at a time, so
+					// that each one can be shown
+	    OneInstruction(instr);
+	    interrupt->OneTick();
+	    if (singleStep && (runUntilTime <= stats->totalTicks))
+		Debugger();
+	} else {
+	    // Nothing can interrupt the program before the next pending
+	    // interrupt is due, so run instructions up to then and charge
+	    // for them all at once.  Any exception ends the batch, since
+	    // the kernel may schedule new interrupts.
+	    int budget = MaxBatch;
+	    int due = interrupt->NextDue();
+	    int numTicks;
+
+	    if ((due >= 0) && (due - stats->totalTicks < MaxBatch * UserTick))
+		budget = divRoundUp(due - stats->totalTicks, UserTick);
+	    if (budget < 1)
+		budget = 1;
+	    while ((pendingTicks < budget) && OneBlock(budget - pendingTicks))
+		;
+	    numTicks = pendingTicks;
+	    pendingTicks = 0;
+	    interrupt->OneTick(numTicks);
+	}
     }
 }
 
 
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Return TRUE if an instruction must be the last one of a basic
+//	block: it may transfer control somewhere other than the next
+//	instruction (branches, jumps, syscalls, illegal instructions).
+//----------------------------------------------------------------------
+
+static bool
+EndsBlock(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ: 
+      case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+      case OP_SYSCALL: case OP_RFE: case OP_RES: case OP_UNIMP:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
 //----------------------------------------------------------------------
 // TypeToReg
 // 	Retrieve the register # referred to in an instruction. 
@@ -100,17 +146,18 @@ TypeToReg(RegType reg, Instruction *instr)
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
-
-    // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-		return;			// exception occurred
-		
-    instr->value = raw;
-    instr->Decode();
+    int physAddr;
+    ExceptionType exception;
+
+    // Fetch instruction.  Each word of physical memory is decoded only
+    // the first time it is executed; after that, the decoded copy is
+    // reused until the page is written to or replaced.
+    exception = CachedTranslate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return;			// exception occurred
+    }
+    *instr = *Predecoded(physAddr);
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -122,6 +169,28 @@ Machine::OneInstruction(Instruction *instr)
        printf("\n");
        }
     
+    (void) ExecuteInstruction(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Carry out the effects of one decoded instruction: update the
+//	registers and memory, do any delayed load, and advance the
+//	program counters.
+//
+//	Returns FALSE if the instruction raised an exception (in which
+//	case the exception has already been handled by the kernel).
+//
+//	"instr" -- the decoded instruction, located at registers[PCReg]
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteInstruction(Instruction *instr)
+{
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -135,7 +204,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -145,7 +214,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -240,7 +309,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -255,10 +324,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -277,10 +346,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -294,7 +363,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -325,7 +394,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -391,13 +460,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -467,7 +536,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -479,7 +548,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -490,7 +559,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -509,7 +578,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -520,7 +589,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -536,12 +605,12 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE;
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -554,7 +623,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -570,6 +639,186 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::OneBlock
+// 	Execute the straight-line basic block of user instructions that
+//	starts at the current PC, as one unit.
+//
+//	A block is translated (predecoded) the first time it is reached,
+//	and cached by its physical address.  It runs up to and including
+//	the first branch, jump or syscall, or to the end of the page,
+//	whichever comes first.  Common instruction pairs are executed by
+//	fused handlers (superinstructions).  Execution stops early if an
+//	instruction raises an exception, if the block's page gets written
+//	to, or once "budget" instructions have run.
+//
+//	Instructions in a branch delay slot are run one at a time, since
+//	the instruction that follows them is not the next one in memory.
+//
+//	Each instruction run is counted in "pendingTicks", including one
+//	that raised an exception.
+//
+//	Returns FALSE if an instruction raised an exception.
+//
+//	"budget" -- the most instructions to run
+//----------------------------------------------------------------------
+
+bool
+Machine::OneBlock(int budget)
+{
+    int physAddr, word, length, executed, value, tmp;
+    ExceptionType exception;
+    Instruction *first, *second;
+    bool ok;
+
+    exception = CachedTranslate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	pendingTicks++;
+	return FALSE;
+    }
+    if (registers[NextPCReg] != registers[PCReg] + 4) {
+	ok = ExecuteInstruction(Predecoded(physAddr));	// in a delay slot
+	pendingTicks++;
+	return ok;
+    }
+    word = physAddr / 4;
+    if (blockLength[word] < 0)
+	TranslateBlock(physAddr);
+    length = blockLength[word];
+    if (length > budget)
+	length = budget;
+
+    for (executed = 0; executed < length; ) {
+	first = &decodeCache[word + executed];
+	second = first + 1;
+	switch ((executed + 1 < length) ? superOp[word + executed] : SUPER_NONE) {
+	  case SUPER_LUI_ORI:
+	    registers[first->rt] = first->extra << 16;
+	    DelayedLoad(0, 0);
+	    registers[second->rt] = registers[second->rs] | 
+					(second->extra & 0xffff);
+	    DelayedLoad(0, 0);
+	    break;
+
+	  case SUPER_LW_ADDU:
+	    tmp = registers[first->rs] + first->extra;
+	    if (tmp & 0x3) {
+		RaiseException(AddressErrorException, tmp);
+		pendingTicks++;
+		return FALSE;
+	    }
+	    if (!ReadMem(tmp, 4, &value)) {
+		pendingTicks++;
+		return FALSE;
+	    }
+	    DelayedLoad(first->rt, value);
+	    registers[second->rd] = registers[second->rs] + 
+					registers[second->rt];
+	    DelayedLoad(0, 0);
+	    break;
+
+	  default:
+	    executed++;
+	    ok = ExecuteInstruction(first);
+	    pendingTicks++;
+	    if (!ok)
+		return FALSE;
+	    if ((executed < length) && !decodeValid[word + executed])
+		return TRUE;		// the block itself was overwritten
+	    continue;
+	}
+	registers[PrevPCReg] = registers[PCReg] + 4;	// the pair ran
+	registers[PCReg] += 8;
+	registers[NextPCReg] = registers[PCReg] + 4;
+	executed += 2;
+	pendingTicks += 2;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateBlock
+// 	Predecode the basic block starting at a physical address, and
+//	record its length and the superinstructions in it.
+//
+//	"physAddr" -- the physical address of the first instruction
+//----------------------------------------------------------------------
+
+void
+Machine::TranslateBlock(int physAddr)
+{
+    int word = physAddr / 4;
+    int pageEnd = (physAddr / PageSize + 1) * PageSize;
+    int length = 0;
+    Instruction *instr, *prev = NULL;
+
+    for (; physAddr < pageEnd; physAddr += 4) {
+	instr = Predecoded(physAddr);
+	superOp[word + length] = SUPER_NONE;
+	if (prev != NULL) {
+	    if ((prev->opCode == OP_LUI) && (instr->opCode == OP_ORI) 
+			&& (instr->rs == prev->rt))
+		superOp[word + length - 1] = SUPER_LUI_ORI;
+	    else if ((prev->opCode == OP_LW) && (instr->opCode == OP_ADDU))
+		superOp[word + length - 1] = SUPER_LW_ADDU;
+	}
+	length++;
+	if (EndsBlock(instr->opCode))
+	    break;
+	prev = instr;
+    }
+    blockLength[word] = length;
+}
+
+//----------------------------------------------------------------------
+// Machine::Predecoded
+// 	Return the decoded form of the instruction at a physical address,
+//	decoding it if this is the first time it has been needed.
+//
+//	"physAddr" -- the (word-aligned) physical address of the instruction
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::Predecoded(int physAddr)
+{
+    int word = physAddr / 4;
+
+    if (!decodeValid[word]) {
+	decodeCache[word].value = 
+		WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+	decodeCache[word].Decode();
+	decodeValid[word] = TRUE;
+	frameDecoded[physAddr / PageSize] = TRUE;
+    }
+    return &decodeCache[word];
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodeCache
+// 	Throw away the predecoded instructions for one physical page.
+//	This also throws away the basic blocks translated from the page.
+//	Called whenever the page's contents change: by WriteMem, and by
+//	the kernel when it loads a different virtual page into the frame.
+//
+//	"frame" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodeCache(int frame)
+{
+    int first = frame * PageSize / 4;
+
+    if (!frameDecoded[frame])
+	return;
+    for (int i = 0; i < PageSize / 4; i++) {
+	decodeValid[first + i] = FALSE;
+	blockLength[first + i] = -1;
+    }
+    frameDecoded[frame] = FALSE;
 }
 
 //----------------------------------------------------------------------
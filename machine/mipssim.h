@@ -87,6 +87,20 @@
 #define OP_RES		63
 #define MaxOpcode	63
 
+/*
+ * Superinstructions: pairs of adjacent instructions inside a translated
+ * basic block that are common enough to be executed by one fused
+ * handler (see Machine::OneBlock).
+ *
+ * SUPER_LUI_ORI -	"lui rt,hi" followed by "ori rd,rt,lo" -- the
+ *			expansion of loading a 32-bit constant.
+ * SUPER_LW_ADDU -	"lw" followed by "addu" in its load delay slot.
+ */
+
+#define SUPER_NONE	0
+#define SUPER_LUI_ORI	1
+#define SUPER_LW_ADDU	2
+
 /*
  * Miscellaneous definitions:
  */
@@ -21,7 +21,18 @@ Statistics::Statistics()
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
-    numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageFaults = numPageOuts = numZeroFills = numPrefetched = 0;
+    numPreZeroed = numFramesZeroed = 0;
+    numDaemonEvictions = 0;
+    numPagesShared = numCopiesOnWrite = numTextShared = 0;
+    numMappedReads = numMappedWrites = 0;
+    numPoolStores = numPoolSameFilled = numPoolRejects = 0;
+    numPoolHits = numPoolSpills = numPoolBytesIn = numPoolBytesOut = 0;
+    numPFFReleases = numSuspensions = 0;
+    tlbSize = tlbWays = 0;
+    numTLBHits = numTLBMisses = numTLBMissTicks = numTLBFlushes = 0;
+    numPacketsSent = numPacketsRecvd = 0;
+    pagePolicy = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -38,7 +49,57 @@ Statistics::Print()
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    if (pagePolicy != NULL)
+	printf("Paging (%s): faults %d, zero-fills %d, prefetched %d, "
+	    "write-backs %d, freed by daemon %d\n", pagePolicy,
+	    numPageFaults, numZeroFills, numPrefetched, numPageOuts,
+	    numDaemonEvictions);
+    else
+	printf("Paging: faults %d\n", numPageFaults);
+    if (numFramesZeroed > 0)
+	printf("Idle zeroing: frames zeroed %d, used by zero-fills %d\n",
+	    numFramesZeroed, numPreZeroed);
+    if (numPagesShared > 0)
+	printf("Copy-on-write: pages shared %d, copied %d\n", numPagesShared,
+	    numCopiesOnWrite);
+    if (numTextShared > 0)
+	printf("Shared code: pages mapped from other processes %d\n",
+	    numTextShared);
+    if (numMappedReads > 0 || numMappedWrites > 0)
+	printf("Mapped files: pages read %d, written back %d\n",
+	    numMappedReads, numMappedWrites);
+    if (numPoolStores > 0 || numPoolRejects > 0)
+	printf("Compressed pool: pages stored %d (same-filled %d), "
+	    "rejected %d, hits %d, spills %d, compression ratio %.2f\n",
+	    numPoolStores, numPoolSameFilled, numPoolRejects, numPoolHits,
+	    numPoolSpills, numPoolBytesOut > 0 ?
+	    (double) numPoolBytesIn / numPoolBytesOut : 0.0);
+    if (numPFFReleases > 0 || numSuspensions > 0)
+	printf("Fault-rate control: frames released %d, suspensions %d\n",
+	    numPFFReleases, numSuspensions);
+    if (tlbSize > 0)
+	PrintTLB("TLB", numTLBHits, numTLBMisses, numTLBMissTicks,
+	    numTLBFlushes);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
 }
+
+//----------------------------------------------------------------------
+// Statistics::PrintTLB
+// 	Print how well the TLB worked for "who" -- the whole system, or
+//	one address space: how often a translation was found in it, how
+//	long a miss took to handle on average, and how many times the TLB
+//	was flushed.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintTLB(const char *who, int hits, int misses, int missTicks,
+		int flushes)
+{
+    int lookups = hits + misses;
+
+    printf("%s (%d entries, %d-way): hits %d, misses %d, hit rate %.2f%%, "
+	"ticks per miss %d, flushes %d\n", who, tlbSize, tlbWays, hits,
+	misses, lookups > 0 ? 100.0 * hits / lookups : 0.0,
+	misses > 0 ? missTicks / misses : 0, flushes);
+}
@@ -33,12 +33,53 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPageOuts;		// number of modified pages written back
+    int numZeroFills;		// number of faults satisfied by zeroing
+				// a frame, without any I/O
+    int numPreZeroed;		// number of those that got a frame
+				// zeroed ahead of time
+    int numFramesZeroed;	// number of frames zeroed while idle
+    int numPrefetched;		// number of pages read in along with
+				// a faulting page
+    int numDaemonEvictions;	// number of frames freed ahead of time
+				// by the pageout daemon
+    int numPagesShared;		// number of pages Fork shared, instead
+				// of copying them
+    int numCopiesOnWrite;	// number of those copied after all
+    int numTextShared;		// number of code page faults satisfied
+				// by another process's copy
+    int numMappedReads;		// number of pages of mapped files read in
+    int numMappedWrites;	// and written back to them
+    int numPoolStores;		// number of pages kept in the compressed
+				// pool, instead of written to swap
+    int numPoolSameFilled;	// number of those that were one word
+				// over and over
+    int numPoolRejects;		// number that didn't compress enough
+    int numPoolHits;		// number of pages read from the pool
+    int numPoolSpills;		// number moved out of it, to swap
+    int numPoolBytesIn;		// bytes of pages stored
+    int numPoolBytesOut;	// and how many they took up in the pool
+    int numPFFReleases;		// number of frames taken away from
+				// processes faulting seldom
+    int numSuspensions;		// number of processes suspended to
+				// make room for the others
+    int tlbSize;		// # of TLB entries, if there is a TLB
+    int tlbWays;		// and # of entries in each of its sets
+    int numTLBHits;		// number of translations found in the TLB
+    int numTLBMisses;		// number of translations that weren't
+    int numTLBMissTicks;	// time spent handling those misses
+    int numTLBFlushes;		// number of times the TLB was flushed
+				// because the ASIDs ran out
+    const char *pagePolicy;	// page replacement policy, if any
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
+    void PrintTLB(const char *who, int hits, int misses, int missTicks,
+		int flushes);	// print TLB statistics, for the system
+				// or one address space
 };
 
 // Constants used to reflect the relative time an operation would
@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -226,6 +227,22 @@ Lseek(int fd, int offset, int whence)
     ASSERT(retVal >= 0);
 }
 
+//----------------------------------------------------------------------
+// FileNumber
+// 	Return a number telling the open file apart from all other files:
+//	its inode number.
+//----------------------------------------------------------------------
+
+int
+FileNumber(int fd)
+{
+    struct stat info;
+    int retVal = fstat(fd, &info);
+
+    ASSERT(retVal == 0);
+    return (int) info.st_ino;
+}
+
 //----------------------------------------------------------------------
 // Tell
 // 	Report the current location within an open file.
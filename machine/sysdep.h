@@ -28,6 +28,7 @@ extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(char *name);
+extern int FileNumber(int fd);
 
 // Interprocess communication operations, for simulating the network
 extern int OpenSocket();
@@ -6,8 +6,8 @@
 //
 // Two types of translation are supported here.
 //
-//	Linear page table -- the virtual page # is used as an index
-//	into the table, to find the physical page #.
+//	Inverted page table -- the address space # and virtual page #
+//	are hashed to find the entry for the page, if it is in memory.
 //
 //	Translation lookaside buffer -- associative lookup in the table
 //	to find an entry with the same virtual page #.  If found,
@@ -34,6 +34,7 @@
 #include "addrspace.h"
 #include "system.h"
 #include <stdio.h>
+#include <string.h>
 
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
@@ -94,7 +95,7 @@ Machine::ReadMem(int addr, int size, int *value)
     
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
+    exception = CachedTranslate(addr, &physicalAddress, size, FALSE);
     if (exception != NoException) {
 		machine->RaiseException(exception, addr);
 		return FALSE;
@@ -143,11 +144,12 @@ Machine::WriteMem(int addr, int size, int value)
      
     DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
+    exception = CachedTranslate(addr, &physicalAddress, size, TRUE);
     if (exception != NoException) {
 		machine->RaiseException(exception, addr);
 		return FALSE;
     }
+    InvalidateDecodeCache(physicalAddress / PageSize);	// code may change
     switch (size) {
       case 1:
 	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
@@ -169,6 +171,136 @@ Machine::WriteMem(int addr, int size, int value)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::KernelTranslate
+// 	Translate a virtual address of the running program on behalf of
+//	the kernel (for instance, to copy a system call's arguments).
+//	Page faults, and stores to pages shared copy-on-write, are handled
+//	on the spot, by calling the kernel's exception handler directly,
+//	and the translation is retried.
+//
+//	Returns FALSE if the address can't be translated at all.
+//
+//	"virtAddr" -- the virtual address to translate
+//	"physAddr" -- the place to store the physical address
+// 	"writing" -- if TRUE, the kernel is going to store there
+//----------------------------------------------------------------------
+
+bool
+Machine::KernelTranslate(int virtAddr, int* physAddr, bool writing)
+{
+    ExceptionType exception;
+
+    exception = CachedTranslate(virtAddr, physAddr, 1, writing);
+    while (exception == PageFaultException
+		|| exception == ReadOnlyException) {
+	registers[BadVAddrReg] = virtAddr;
+	ExceptionHandler(exception);
+	exception = CachedTranslate(virtAddr, physAddr, 1, writing);
+    }
+    if (exception != NoException) {
+	DEBUG('a', "Kernel access to bad address 0x%x\n", virtAddr);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyIn
+// 	Copy "size" bytes of virtual memory, starting at "virtAddr", into
+//	the kernel buffer "buffer".  Each page is translated once, and
+//	the part of it that is needed is copied in one piece.
+//
+//   	Returns FALSE if some part of the range couldn't be translated.
+//----------------------------------------------------------------------
+
+bool
+Machine::CopyIn(int virtAddr, char *buffer, int size)
+{
+    int physAddr, chunk;
+
+    DEBUG('a', "Copying in %d bytes from VA 0x%x\n", size, virtAddr);
+    while (size > 0) {
+	if (!KernelTranslate(virtAddr, &physAddr, FALSE))
+	    return FALSE;
+	chunk = PageSize - (unsigned) virtAddr % PageSize;
+	if (chunk > size)
+	    chunk = size;
+	memcpy(buffer, &mainMemory[physAddr], chunk);
+	virtAddr += chunk;
+	buffer += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyOut
+// 	Copy "size" bytes from the kernel buffer "buffer" into virtual
+//	memory, starting at "virtAddr", a page at a time.
+//
+//   	Returns FALSE if some part of the range couldn't be translated;
+//	the pages before it have already been written.
+//----------------------------------------------------------------------
+
+bool
+Machine::CopyOut(int virtAddr, char *buffer, int size)
+{
+    int physAddr, chunk;
+
+    DEBUG('a', "Copying out %d bytes to VA 0x%x\n", size, virtAddr);
+    while (size > 0) {
+	if (!KernelTranslate(virtAddr, &physAddr, TRUE))
+	    return FALSE;
+	chunk = PageSize - (unsigned) virtAddr % PageSize;
+	if (chunk > size)
+	    chunk = size;
+	InvalidateDecodeCache(physAddr / PageSize);	// code may change
+	memcpy(&mainMemory[physAddr], buffer, chunk);
+	virtAddr += chunk;
+	buffer += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::CopyInString
+// 	Copy a null-terminated string out of virtual memory, starting at
+//	"virtAddr", into "buffer", which has room for "size" bytes
+//	(including the null).  Copies a page at a time, stopping at the
+//	page that holds the null.
+//
+//   	Returns the length of the string, or -1 if it doesn't fit or
+//	runs into a bad address.
+//----------------------------------------------------------------------
+
+int
+Machine::CopyInString(int virtAddr, char *buffer, int size)
+{
+    int physAddr, chunk;
+    int length = 0;
+    char *last;
+
+    while (length < size) {
+	if (!KernelTranslate(virtAddr, &physAddr, FALSE))
+	    return -1;
+	chunk = PageSize - (unsigned) virtAddr % PageSize;
+	if (chunk > size - length)
+	    chunk = size - length;
+	last = (char *) memchr(&mainMemory[physAddr], '\0', chunk);
+	if (last != NULL)
+	    chunk = last - &mainMemory[physAddr] + 1;
+	memcpy(buffer + length, &mainMemory[physAddr], chunk);
+	length += chunk;
+	if (last != NULL)
+	    return length - 1;
+	virtAddr += chunk;
+    }
+    DEBUG('a', "String at VA 0x%x is longer than %d\n", virtAddr, size);
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -200,63 +332,50 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	return AddressErrorException;
     }
     
-	int tmp = tlb == NULL;
-	int tmp2 = pageTable == NULL;
-	//printf("tlb is null? %d\n", tmp);
-	//printf("pagetable is null? %d\n", tmp2);
-    // we must have either a TLB or a page table, but not both!
-    //ASSERT(tlb == NULL || pageTable == NULL);	
-    //ASSERT(tlb != NULL || pageTable != NULL);	
+    // the page table always exists; the TLB, if there is one, caches it
+    ASSERT(pageTable != NULL);
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
-    vpn = (unsigned) virtAddr / PageSize;
-    offset = (unsigned) virtAddr % PageSize;
+    vpn = (unsigned) virtAddr >> pageShift;
+    offset = (unsigned) virtAddr & (PageSize - 1);
     
-    if (tlb == NULL) {		// => page table => vpn is index into table
+    if (tlb == NULL) {		// => page table => look up (space, vpn)
 		if (vpn >= pageTableSize) {
 			DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 				virtAddr, pageTableSize);
 			return AddressErrorException;
 		}
-		/*
-		else if (!pageTable[vpn].valid) {
-			DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
-				virtAddr, pageTableSize);
+		entry = pageTable->Lookup(currentSpace, vpn);
+		if (entry == NULL) {
+			DEBUG('a', "virtual page # %d not in memory!\n", vpn);
 			return PageFaultException;
-		}*/
-		int pos = -1;
-		for (int i = 0; i < NumPhysPages; i++) {
-			if (pageTable[i].virtualPage == vpn)
-				pos = i;
 		}
-		if (pos == -1) {
-			return PageFaultException;
-		}
-		entry = &pageTable[pos];
+		i = -1;
     }
 	else {
-		// scan the TLB to find the entry
-		int find = -1;
-        for (entry = NULL, i = 0; i < TLBSize; i++) {
-    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
-				find = i;
+		// scan the set the page maps to, for an entry of the running
+		// address space
+		int first = (vpn % numTLBSets) * TLBWays;
+        for (entry = NULL, i = first; i < first + TLBWays; i++) {
+    	    if (tlb[i].valid && (tlb[i].virtualPage == (int) vpn)
+				&& tlb[i].asid == currentASID) {
 				entry = &tlb[i];			// FOUND!
-				entry->cnt = 0;
-				TLBhit++;
+				TouchTLB(i);
 				break;
 	    	}
 		}
-		
-		if (find != -1) {
-			for (int i = 0; i < TLBSize; i++) {
-				if (i == find) continue;
-				tlb[i].cnt++;
+		if (entry == NULL && numTLBEntries > TLBSize) {
+			i = TLBSize;		// a direct-mapped TLB's extra entry
+			if (tlb[i].valid && (tlb[i].virtualPage == (int) vpn)
+					&& tlb[i].asid == currentASID) {
+				entry = &tlb[i];
+				TouchTLB(i);
 			}
 		}
 		
 		if (entry == NULL) {				// not found
-			TLBmiss++;
+			stats->numTLBMisses++;
     	    DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
@@ -272,7 +391,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned) NumPhysPages) { 
 		DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 		return BusErrorException;
     }
@@ -280,9 +399,232 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     if (writing)
 		entry->dirty = TRUE;
 
+    lastTLBEntry = i;
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
 
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::TouchTLB
+// 	Count a hit on TLB slot "entry", and make it the most recently
+//	used slot of its set, by moving it to the front of the set's
+//	circular list.  The extra entry of a direct-mapped TLB is in no
+//	set.
+//----------------------------------------------------------------------
+
+void
+Machine::TouchTLB(int entry)
+{
+    stats->numTLBHits++;
+    if (entry == TLBSize)
+	return;
+
+    int set = entry / TLBWays;
+    int recent = tlbMostRecent[set];
+    int least = tlbNewer[recent];
+
+    if (entry == recent)
+	return;
+    if (entry != least) {	// take it out, and put it back in between
+				// the least and the most recently used
+	tlbNewer[tlbOlder[entry]] = tlbNewer[entry];
+	tlbOlder[tlbNewer[entry]] = tlbOlder[entry];
+	tlbOlder[entry] = recent;
+	tlbNewer[entry] = least;
+	tlbNewer[recent] = entry;
+	tlbOlder[least] = entry;
+    }
+    tlbMostRecent[set] = entry;	// the list is circular, so that makes
+				// it the most recent
+}
+
+//----------------------------------------------------------------------
+// Machine::TLBVictim
+// 	Return the TLB slot the kernel should load a translation of
+//	virtual page "vpn" into: an empty slot of the set the page maps
+//	to, if it has one, or else the set's least recently used slot.
+//	The empty slots are looked for from the least recently used end.
+//----------------------------------------------------------------------
+
+int
+Machine::TLBVictim(int vpn)
+{
+    int least = tlbNewer[tlbMostRecent[vpn % numTLBSets]];
+    int slot = least;
+
+    for (int n = 0; n < TLBWays; n++, slot = tlbNewer[slot])
+	if (!tlb[slot].valid)
+	    return slot;
+    return least;
+}
+
+//----------------------------------------------------------------------
+// Machine::CachedTranslate
+// 	Like Translate, but first look the page up in the host translation
+//	cache.  A hit skips the page table or TLB walk altogether; the use
+//	bit (and the dirty bit, for a store) was already set by the
+//	Translate that filled the entry.  A miss calls Translate and, if it
+//	succeeds, caches the page.
+//----------------------------------------------------------------------
+
+ExceptionType
+Machine::CachedTranslate(int virtAddr, int* physAddr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr >> pageShift;
+    unsigned int offset = (unsigned) virtAddr & (PageSize - 1);
+    HostTranslation *cached = &hostTLB[vpn % HostTLBSize];
+    ExceptionType exception;
+
+    if (cached->virtualPage == vpn && (cached->writable || !writing)
+		&& (virtAddr & (size - 1)) == 0) {
+	if (cached->tlbEntry >= 0)
+	    TouchTLB(cached->tlbEntry);
+	*physAddr = (cached->page - mainMemory) + offset;
+	return NoException;
+    }
+
+    exception = Translate(virtAddr, physAddr, size, writing);
+    if (exception == NoException) {
+	if (cached->virtualPage != vpn)
+	    cached->writable = FALSE;
+	cached->virtualPage = vpn;
+	cached->page = &mainMemory[*physAddr - offset];
+	cached->writable = cached->writable || writing;
+	cached->tlbEntry = lastTLBEntry;
+    }
+    return exception;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushHostTLB
+// 	Empty the host translation cache.  Called on a context switch, and
+//	whenever the kernel edits a page table or TLB entry, since cached
+//	pages bypass both.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushHostTLB()
+{
+    for (int i = 0; i < HostTLBSize; i++)
+	hostTLB[i].virtualPage = (unsigned) -1;
+}
+
+// An entry in one of the InvertedPageTable's hash chains.
+
+class HashedEntry {
+  public:
+    int space;			// the address space the mapping belongs to
+    TranslationEntry entry;	// the mapping itself
+    HashedEntry *next;		// next entry in the same chain
+};
+
+//----------------------------------------------------------------------
+// InvertedPageTable::InvertedPageTable
+// 	Initialize an empty inverted page table.
+//
+//	"size" -- the number of hash chains; about one per physical
+//		page keeps the chains short
+//----------------------------------------------------------------------
+
+InvertedPageTable::InvertedPageTable(int size)
+{
+    numBuckets = size;
+    buckets = new HashedEntry *[numBuckets];
+    for (int i = 0; i < numBuckets; i++)
+	buckets[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::~InvertedPageTable
+// 	De-allocate an inverted page table, and all of its entries.
+//----------------------------------------------------------------------
+
+InvertedPageTable::~InvertedPageTable()
+{
+    for (int i = 0; i < numBuckets; i++) {
+	while (buckets[i] != NULL) {
+	    HashedEntry *next = buckets[i]->next;
+	    delete buckets[i];
+	    buckets[i] = next;
+	}
+    }
+    delete [] buckets;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Hash
+// 	Return the chain that the mapping of "vpn" in "space" lives on.
+//----------------------------------------------------------------------
+
+int
+InvertedPageTable::Hash(int space, int vpn)
+{
+    return ((unsigned) space * 37 + (unsigned) vpn) % numBuckets;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Lookup
+// 	Find the translation for virtual page "vpn" of address space
+//	"space".  Returns NULL if the page isn't in physical memory.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+InvertedPageTable::Lookup(int space, int vpn)
+{
+    HashedEntry *ptr;
+
+    for (ptr = buckets[Hash(space, vpn)]; ptr != NULL; ptr = ptr->next)
+	if (ptr->space == space && ptr->entry.virtualPage == vpn)
+	    return &ptr->entry;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Insert
+// 	Map virtual page "vpn" of address space "space" to physical page
+//	"frame".  The page must not already be mapped.  Returns the new
+//	entry, so that the caller can adjust its bits (e.g., read-only).
+//----------------------------------------------------------------------
+
+TranslationEntry *
+InvertedPageTable::Insert(int space, int vpn, int frame)
+{
+    HashedEntry *element = new HashedEntry;
+    int bucket = Hash(space, vpn);
+
+    ASSERT(Lookup(space, vpn) == NULL);
+    element->space = space;
+    element->entry.virtualPage = vpn;
+    element->entry.physicalPage = frame;
+    element->entry.valid = TRUE;
+    element->entry.readOnly = FALSE;
+    element->entry.use = FALSE;
+    element->entry.dirty = FALSE;
+    element->next = buckets[bucket];
+    buckets[bucket] = element;
+    return &element->entry;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Remove
+// 	Drop the translation for virtual page "vpn" of address space
+//	"space", if there is one.
+//----------------------------------------------------------------------
+
+void
+InvertedPageTable::Remove(int space, int vpn)
+{
+    HashedEntry **ptr;
+
+    for (ptr = &buckets[Hash(space, vpn)]; *ptr != NULL; ptr = &(*ptr)->next) {
+	if ((*ptr)->space == space && (*ptr)->entry.virtualPage == vpn) {
+	    HashedEntry *element = *ptr;
+	    *ptr = element->next;
+	    delete element;
+	    return;
+	}
+    }
+}
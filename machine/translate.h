@@ -26,21 +26,61 @@
 // virtual page to one physical page.
 // In addition, there are some extra bits for access control (valid and 
 // read-only) and some bits for usage information (use and dirty).
+//
+// The physical page # and the four bits are packed into one word, which
+// is all that Translate reads (and, to set the use and dirty bits, writes)
+// once it has found the entry.
+
+#define PhysicalPageBits	28	// bits for the physical page #
 
 class TranslationEntry {
   public:
     int virtualPage;  	// The page number in virtual memory.
-    int physicalPage;  	// The page number in real memory (relative to the
+    unsigned int physicalPage : PhysicalPageBits;
+			// The page number in real memory (relative to the
 			//  start of "mainMemory"
-    bool valid;         // If this bit is set, the translation is ignored.
+    bool valid : 1;     // If this bit is set, the translation is ignored.
 			// (In other words, the entry hasn't been initialized.)
-    bool readOnly;	// If this bit is set, the user program is not allowed
+    bool readOnly : 1;	// If this bit is set, the user program is not allowed
 			// to modify the contents of the page.
-    bool use;           // This bit is set by the hardware every time the
+    bool use : 1;       // This bit is set by the hardware every time the
 			// page is referenced or modified.
-    bool dirty;         // This bit is set by the hardware every time the
+    bool dirty : 1;     // This bit is set by the hardware every time the
 			// page is modified.
-    int cnt;
+    int asid;		// In the TLB, the address space the entry belongs
+			// to; it only matches while that one is running.
+};
+
+// The following class defines an inverted page table: one table, shared
+// by every address space, holding a TranslationEntry for each virtual
+// page that is currently in physical memory.  Entries are found by
+// hashing the pair <address space #, virtual page #>, so a lookup costs
+// the same no matter how much physical memory there is.
+//
+// A physical page may be mapped more than once (by different address
+// spaces, or at different virtual pages), so the table grows as needed
+// rather than having exactly one slot per physical page.
+
+class HashedEntry;
+
+class InvertedPageTable {
+  public:
+    InvertedPageTable(int size);	// Initialize an empty table
+    ~InvertedPageTable();		// De-allocate the table
+
+    TranslationEntry *Lookup(int space, int vpn);
+					// Return the mapping of "vpn" in
+					// "space", or NULL if there is none
+    TranslationEntry *Insert(int space, int vpn, int frame);
+					// Map "vpn" in "space" to "frame";
+					// the new entry is valid but unused
+    void Remove(int space, int vpn);	// Drop the mapping of "vpn" in "space"
+
+  private:
+    HashedEntry **buckets;		// chains of entries, by hash value
+    int numBuckets;
+
+    int Hash(int space, int vpn);
 };
 
 #endif
@@ -0,0 +1,32 @@
+#include "syscall.h"
+
+#define SIZE 1024
+
+int data[SIZE];		// shared with the child until one of us writes
+
+void child() {
+    int i;
+
+    for (i = 0; i < SIZE; i++)
+        if (data[i] != i)	// it should start out with our memory
+            Exit(1);
+    for (i = 0; i < SIZE; i++)
+        data[i] = -1;		// gets it a copy of its own
+    Exit(0);
+}
+
+int main() {
+    SpaceId id;
+    int i;
+
+    for (i = 0; i < SIZE; i++)
+        data[i] = i;
+    id = Fork(child);
+    if (id == -1)
+        Exit(2);
+    Join(id);
+    for (i = 0; i < SIZE; i++)
+        if (data[i] != i)	// the child's writes must not reach us
+            Exit(3);
+    Exit(100);
+}
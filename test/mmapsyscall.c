@@ -0,0 +1,50 @@
+#include "syscall.h"
+
+#define LENGTH 300		// a few pages, the last one partly
+
+int main() {
+    char name[9];
+    char buffer[LENGTH];
+    char *mapped;
+    OpenFileId fid;
+    int i;
+
+    name[0] = 'm';
+    name[1] = 'm';
+    name[2] = 'a';
+    name[3] = 'p';
+    name[4] = '.';
+    name[5] = 't';
+    name[6] = 'x';
+    name[7] = 't';
+    name[8] = '\0';
+
+    Create(name);
+    fid = Open(name);
+    for (i = 0; i < LENGTH; i++)
+        buffer[i] = 'a' + i % 26;
+    Write(buffer, LENGTH, fid);
+
+    mapped = (char *) Mmap(fid, LENGTH);
+    if (mapped == (char *) -1)
+        Exit(1);
+    for (i = 0; i < LENGTH; i++)
+        if (mapped[i] != buffer[i])	// reads the file
+            Exit(2);
+    for (i = 0; i < LENGTH; i++)
+        mapped[i] = 'A' + i % 26;	// writes it, without Write
+    if (Munmap((int) mapped) != 0)
+        Exit(3);
+    if (Munmap((int) mapped) != -1)	// not mapped any more
+        Exit(4);
+    Close(fid);
+
+    fid = Open(name);			// read it back from the start
+    if (Read(buffer, LENGTH, fid) != LENGTH)
+        Exit(5);
+    for (i = 0; i < LENGTH; i++)
+        if (buffer[i] != 'A' + i % 26)	// the changes reached the file
+            Exit(6);
+    Close(fid);
+    Exit(100);
+}
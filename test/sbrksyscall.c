@@ -0,0 +1,50 @@
+#include "syscall.h"
+
+#define HEAP_SIZE 4096
+#define FRAME_SIZE 4096		// well past the stack a program starts with
+
+// Fill a stack frame bigger than the initial stack, so that the stack
+// has to grow below its old limit, and read it back.
+
+int deep() {
+    char frame[FRAME_SIZE];
+    int i;
+
+    for (i = 0; i < FRAME_SIZE; i++)
+        frame[i] = i;
+    for (i = 0; i < FRAME_SIZE; i++)
+        if (frame[i] != (char) i)
+            return 0;
+    return 1;
+}
+
+int main() {
+    char *heap;
+    int i;
+
+    heap = (char *) Sbrk(HEAP_SIZE);	// past the old end of the heap
+    if (heap == (char *) -1)
+        Exit(1);
+    for (i = 0; i < HEAP_SIZE; i++)
+        if (heap[i] != 0)
+            Exit(2);
+    for (i = 0; i < HEAP_SIZE; i++)
+        heap[i] = i;
+    for (i = 0; i < HEAP_SIZE; i++)
+        if (heap[i] != (char) i)
+            Exit(3);
+
+    if (Sbrk(-HEAP_SIZE) != (int) heap + HEAP_SIZE)
+        Exit(4);
+    if (Sbrk(0) != (int) heap)		// shrunk back
+        Exit(5);
+    if (Sbrk(HEAP_SIZE) != (int) heap)
+        Exit(6);
+    for (i = 0; i < HEAP_SIZE; i++)
+        if (heap[i] != 0)		// what was there is gone
+            Exit(7);
+
+    if (!deep())
+        Exit(8);
+    Exit(100);
+}
@@ -10,6 +10,10 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
+//		-mem <# of pages> -pgsz <page size> -tlb <# of TLB entries>
+//		-tlbways <# of entries per set>
+//		-rp <replacement policy> -fa <# of pages> -sd -zp <# of pages>
+//		-pff <# of ticks>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
@@ -24,6 +28,25 @@
 //    -s causes user programs to be executed in single-step mode
 //    -x runs a user program
 //    -c tests the console
+//    -mem sets the number of physical pages of memory (default 64)
+//    -pgsz sets the page size in bytes, a power of two (default 128)
+//    -tlb sets the number of TLB entries, if there is a TLB (default 4)
+//    -tlbways sets how many TLB entries each virtual page can go in:
+//	1 makes the TLB direct-mapped, 0 fully associative (default 0)
+//    -rp picks the page replacement policy: fifo, second, clock,
+//	aging or wsclock (default clock)
+//    -fa sets how many pages to read in on a page fault, to start with;
+//	sequential faults double it, up to 16 (default 2, 1 turns it off)
+//    -sd keeps swapped-out pages on a disk of their own, simulated by
+//	the UNIX file "SWAP", instead of in a file
+//    -zp keeps pages written to swap compressed in memory, in at most
+//	that many pages' worth of bytes, before they go to swap
+//	(default 0, no compressed pool)
+//    -pff gives a process more frames while it faults more often than
+//	once every that many ticks of its own running time, takes away
+//	the ones it doesn't use while it faults less often, and suspends
+//	processes when there aren't enough frames to go round
+//	(default 0, global replacement only)
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
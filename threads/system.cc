@@ -30,6 +30,11 @@ SynchDisk   *synchDisk;
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+CoreMap *coreMap;	// owners of the physical page frames
+SwapSpace *swapSpace;	// backing store for modified pages
+Lock *vmLock;		// held while paging
+PageoutDaemon *pageoutDaemon;	// keeps some frames free
+PFFController *pffController;	// shares the frames out
 #endif
 
 #ifdef NETWORK
@@ -87,6 +92,7 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    const char *pagePolicy = "clock";	// page replacement policy
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -115,6 +121,43 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    NumPhysPages = atoi(*(argv + 1));	// # of physical pages
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pgsz")) {
+	    ASSERT(argc > 1);
+	    PageSize = atoi(*(argv + 1));	// bytes per page
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    TLBSize = atoi(*(argv + 1));	// # of TLB entries
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlbways")) {
+	    ASSERT(argc > 1);
+	    TLBWays = atoi(*(argv + 1));	// # of entries per set
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-fa")) {
+	    ASSERT(argc > 1);
+	    FaultAroundPages = atoi(*(argv + 1));	// 1 turns it off
+	    ASSERT((FaultAroundPages >= 1)
+			&& (FaultAroundPages <= MaxFaultAround));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-rp")) {
+	    ASSERT(argc > 1);
+	    pagePolicy = *(argv + 1);		// see userprog/replace.h
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-sd"))
+	    UseSwapDisk = TRUE;			// see userprog/swap.h
+	else if (!strcmp(*argv, "-zp")) {
+	    ASSERT(argc > 1);
+	    PoolBudgetPages = atoi(*(argv + 1));	// see userprog/cpool.h
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pff")) {
+	    ASSERT(argc > 1);
+	    PFFInterval = atoi(*(argv + 1));	// see userprog/pff.h
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -157,6 +200,8 @@ Initialize(int argc, char **argv)
     
 #ifdef USER_PROGRAM
     machine = new Machine(debugUserProg);	// this must come first
+    coreMap = new CoreMap(NumPhysPages, pagePolicy);
+    stats->pagePolicy = coreMap->PolicyName();
 #endif
 
 #ifdef FILESYS
@@ -167,6 +212,14 @@ Initialize(int argc, char **argv)
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef USER_PROGRAM
+    swapSpace = new SwapSpace(NumSwapSlots);	// needs the file system
+    vmLock = new Lock("vm");
+    pageoutDaemon = new PageoutDaemon(NumPhysPages);
+    pageoutDaemon->Start();
+    pffController = new PFFController(PFFInterval);
+#endif
+
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, 10);
 #endif
@@ -185,6 +238,8 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete swapSpace;
+    delete coreMap;
     delete machine;
 #endif
 
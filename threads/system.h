@@ -31,7 +31,16 @@ extern Timer *timer;				// the hardware alarm clock
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "coremap.h"
+#include "swap.h"
+#include "pageout.h"
+#include "pff.h"
 extern Machine* machine;	// user program memory and registers
+extern CoreMap *coreMap;	// owners of the physical page frames
+extern SwapSpace *swapSpace;	// backing store for modified pages
+extern Lock *vmLock;		// held while paging
+extern PageoutDaemon *pageoutDaemon;	// keeps some frames free
+extern PFFController *pffController;	// shares the frames out
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -21,160 +21,219 @@
 #include "noff.h"
 #include "openfile.h"
 #include <stdio.h>
+#include <string.h>
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
 
-//----------------------------------------------------------------------
-// SwapHeader
-// 	Do little endian to big endian conversion on the bytes in the 
-//	object file header, in case the file was generated on a little
-//	endian machine, and we're now running on a big endian machine.
-//----------------------------------------------------------------------
+static int nextSpaceId = 0;	// space # for the next AddrSpace
 
-static void 
-SwapHeader (NoffHeader *noffH)
-{
-	noffH->noffMagic = WordToHost(noffH->noffMagic);
-	noffH->code.size = WordToHost(noffH->code.size);
-	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
-	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
-	noffH->initData.size = WordToHost(noffH->initData.size);
-	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
-	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
-	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
-	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
-	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
-}
+// ASIDs are handed out in order, and only given back all at once: when
+// they run out, the TLB is flushed and a new generation starts.  An
+// address space whose ASID is from an older generation gets a new one
+// the next time it runs.
+static int generation = 1;		// the current generation of ASIDs
+static int nextASID = 0;		// the next ASID to hand out in it
+static AddrSpace *asidOwners[NumASIDs];	// who has each ASID handed out
+
+int FaultAroundPages = DefaultFaultAround;
 
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
-//	Load the program from a file "executable", and set everything
-//	up so that we can start executing user instructions.
+//	The program is loaded from the file "executable" a page at a time,
+//	as it is touched, so the address space keeps the file open, in
+//	an ExecImage, until it (and any copies Fork made of it) is
+//	deleted.
 //
 //	Assumes that the object code file is in NOFF format.
 //
+//	Every address space is UserSpaceSize bytes.  The code and data
+//	are at the bottom, and are followed by the heap, which starts
+//	out empty and is grown and shrunk with Sbrk.  The stack is at the
+//	top, and grows down as the program touches the pages below it, to
+//	at most MaxStackSize.  Files mapped with Mmap go right below the
+//	room the stack may grow into.  Anything else in between isn't
+//	part of the program's memory at all; since nothing about those
+//	pages is kept, they cost nothing (see pagemap.h).
+//
 //	First, set up the translation from program memory to physical 
-//	memory.  For now, this is really simple (1:1), since we are
-//	only uniprogramming, and we have a single unsegmented page table
+//	memory.  Every address space shares the machine's inverted page
+//	table, and is told apart in it by a unique space #.
+//
+//	The program may be too big to run; the caller must check Fits
+//	before running it.
 //
 //	"executable" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
 
 AddrSpace::AddrSpace(OpenFile *executable)
 {
-    NoffHeader noffH;
-    unsigned int i, size;
-
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
-
-// how big is address space?
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
-			+ UserStackSize;	// we need to increase the size
-						// to leave room for the stack
-    numPages = divRoundUp(size, PageSize);
-    size = numPages * PageSize;
-    //printf("numpages: %d\n", numPages);
-    //printf("numphyspage: %d\n", NumPhysPages);
-    ASSERT(numPages <= NumPhysPages);		// check we're not trying
-						// to run anything too big --
-						// at least until we have
-						// virtual memory
-
-    DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
+    unsigned int size;
+
+    image = OpenImage(executable);
+    NoffHeader noffH = image->noffH;
+
+// how big is the program?
+    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size;
+    heapStart = brk = divRoundUp(size, PageSize) * PageSize;
+    numPages = divRoundUp(UserSpaceSize, PageSize);
+    stackPage = numPages - divRoundUp(UserStackSize, PageSize);
+    stackLimit = numPages - divRoundUp(MaxStackSize, PageSize);
+    mappings = NULL;
+    mmapBase = stackLimit;
+
+    DEBUG('a', "Initializing address space, num pages %d, program size %d\n", 
 					numPages, size);
-// first, set up the translation 
-    //pageTable = new TranslationEntry[numPages];
-    pageTable = new TranslationEntry[NumPhysPages];
-    for (i = 0; i < NumPhysPages; i++) {
-        pageTable[i].virtualPage = -1;	// for now, virtual page # = phys page #
-        //pageTable[i].physicalPage = machine->bitmap->find();
-        pageTable[i].physicalPage = i;
-        pageTable[i].valid = FALSE;
-
-        pageTable[i].use = FALSE;
-        pageTable[i].dirty = FALSE;
-        pageTable[i].readOnly = FALSE;  // if the code segment was entirely on 
-                        // a separate page, we could set its 
-                        // pages to be read-only
-    }
-    
-    fileSystem->Create("virtual_memory", size);
-    OpenFile *openfile = fileSystem->Open("virtual_memory");
-    if (openfile == NULL)
-        ASSERT(false);
-    if (noffH.code.size > 0) {
-        int pos1 = noffH.code.inFileAddr;
-        int pos2 = noffH.code.virtualAddr;
-        char current_char;
-        for (int j = 0; j < noffH.code.size; j++) {
-            executable->ReadAt(&(current_char), 1, pos1++);
-            openfile->WriteAt(&(current_char), 1, pos2++);
-        }
-    }
-    if (noffH.initData.size > 0) {
-        int pos1 = noffH.initData.inFileAddr;
-        int pos2 = noffH.initData.virtualAddr;
-        char current_char;
-        for (int j = 0; j < noffH.initData.size; j++) {
-            executable->ReadAt(&(current_char), 1, pos1++);
-            openfile->WriteAt(&(current_char), 1, pos2++);
-        }
-    }
-    delete openfile;
-
-// zero out the entire address space, to zero the unitialized data segment 
-// and the stack segment
-    //bzero(machine->mainMemory, size);
-
-// then, copy in the code and data segments into memory
-/*
-    if (noffH.code.size > 0) {
-        DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
-			noffH.code.virtualAddr, noffH.code.size);
-        
-        //executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr]),
-		//	noffH.code.size, noffH.code.inFileAddr);
-        
-        int code_pos = noffH.code.inFileAddr;
-        for (int i = 0; i < noffH.code.size; i++) {
-            int vpn = (noffH.code.virtualAddr + i) / PageSize;
-            int offset = (noffH.code.virtualAddr + i) % PageSize;
-            int phyAddr = pageTable[vpn].physicalPage * PageSize + offset;
-            executable->ReadAt(&(machine->mainMemory[phyAddr]), 1, code_pos++);
-        }
-    }
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
-			noffH.initData.virtualAddr, noffH.initData.size);
-        
-        //executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr]),
-		//	noffH.initData.size, noffH.initData.inFileAddr);
-        
-        int data_pos = noffH.initData.inFileAddr;
-        for (int i = 0; i < noffH.initData.size; i++) {
-            int vpn = (noffH.initData.virtualAddr + i) / PageSize;
-            int offset = (noffH.initData.virtualAddr + i) % PageSize;
-            int phyAddr = pageTable[vpn].physicalPage * PageSize + offset;
-            executable->ReadAt(&(machine->mainMemory[phyAddr]), 1, data_pos++);
+// first, set up the translation: nothing is in memory yet, so the
+// inverted page table holds no entries for this space until it faults
+    spaceId = nextSpaceId++;
+
+// nothing is loaded yet either: each page is read from the executable
+// (or zero-filled) the first time it is touched, and only goes to swap
+// once it has been modified.  The pages past the end of the code and
+// initialized data -- the uninitialized data and the stack -- are
+// zero-filled without reading anything.
+    firstZeroPage = 0;
+    if (noffH.code.size > 0)		// an empty segment's address is junk
+	firstZeroPage = divRoundUp(noffH.code.virtualAddr + noffH.code.size,
+				PageSize);
+    if (noffH.initData.size > 0)
+	firstZeroPage = max(firstZeroPage, divRoundUp(noffH.initData.virtualAddr
+				+ noffH.initData.size, PageSize));
+    swapSlots = new PageMap(numPages);
+    faultWindow = FaultAroundPages;
+    nextSequential = -1;
+    asid = -1;
+    asidGeneration = 0;			// none yet; see RestoreState
+    tlbHits = tlbMisses = tlbMissTicks = tlbFlushes = 0;
+    hitsAtSwitch = missesAtSwitch = 0;
+    runTicks = ticksAtSwitch = lastFault = 0;
+    numResident = maxResident = numSuspensions = 0;
+    suspended = FALSE;
+
+    vmLock->Acquire();
+    pffController->Add(this);
+    vmLock->Release();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create a copy of address space "parent", for Fork, without
+//	copying any pages: the copy is loaded from the same executable,
+//	shares the parent's swap slots, and maps the parent's frames.
+//
+//	The shared frames are made read-only in both address spaces, so
+//	whichever writes to one first gets a copy of its own then (see
+//	CopyOnWrite in exception.cc).  A page the parent had modified is
+//	now modified on behalf of both, so the frame remembers it is
+//	dirty.
+//
+//	Files the parent has mapped with Mmap are not mapped in the copy.
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent)
+{
+    TranslationEntry *entry, *copy;
+
+    image = parent->image;
+    image->Attach();
+    numPages = parent->numPages;
+    firstZeroPage = parent->firstZeroPage;
+    heapStart = parent->heapStart;
+    brk = parent->brk;
+    stackPage = parent->stackPage;
+    stackLimit = parent->stackLimit;
+    mappings = NULL;
+    mmapBase = stackLimit;
+    spaceId = nextSpaceId++;
+    DEBUG('a', "Forking address space %d from %d, num pages %d\n",
+					spaceId, parent->spaceId, numPages);
+    runTicks = ticksAtSwitch = lastFault = 0;
+    numResident = maxResident = numSuspensions = 0;	// the frames it
+    suspended = FALSE;				// shares are the parent's
+
+    vmLock->Acquire();
+    pffController->Add(this);
+    parent->UnloadTLB();		// merge the TLB's use, dirty bits,
+					// and drop the writable entries
+    swapSlots = new PageMap(parent->swapSlots);
+    for (int vpn = 0; vpn < (int) numPages; vpn = NextPage(vpn)) {
+        if (swapSlots->Get(vpn) != -1)
+            swapSpace->ShareSlot(swapSlots->Get(vpn));
+
+        entry = machine->pageTable->Lookup(parent->spaceId, vpn);
+        if (entry != NULL) {
+            if (entry->dirty)
+                coreMap->Frame(entry->physicalPage)->dirty = TRUE;
+            entry->dirty = FALSE;
+            entry->readOnly = TRUE;
+            copy = machine->pageTable->Insert(spaceId, vpn,
+                                              entry->physicalPage);
+            copy->readOnly = TRUE;
+            coreMap->Share(entry->physicalPage, this);
+            stats->numPagesShared++;
         }
     }
-    */
+    machine->FlushHostTLB();		// cached pages may be writable
+    vmLock->Release();
+    faultWindow = FaultAroundPages;
+    nextSequential = -1;
+    asid = -1;
+    asidGeneration = 0;			// none yet; see RestoreState
+    tlbHits = tlbMisses = tlbMissTicks = tlbFlushes = 0;
+    hitsAtSwitch = missesAtSwitch = 0;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Fits
+// 	Return TRUE if the program fits in its address space: its code
+//	and data below the room the stack may grow into, and they and
+//	the initial stack in the swap area, where pages that don't fit
+//	in memory go.  The swap disk may hold fewer than NumSwapSlots
+//	pages, so ask the swap area how many it really has.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Fits()
+{
+    int dataPages = heapStart / PageSize;
+
+    return dataPages <= stackLimit
+	&& dataPages + (int) numPages - stackPage <= swapSpace->NumSlots();
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space: unmap its mapped files, writing
+//	back what was changed in them, drop its pages from the inverted
+//	page table, and give their frames back to the core map and their
+//	slots back to the swap area, unless other address spaces made by
+//	Fork still share them.  The PFF controller forgets about it.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+    vmLock->Acquire();			// not while a page is moving
+    UnloadTLB();			// its translations may still be
+    if (HasASID())			// loaded
+        asidOwners[asid] = NULL;
+    if (machine->currentSpace == spaceId)
+        machine->FlushHostTLB();
+    while (mappings != NULL) {
+        FileMapping *mapping = mappings;
+
+        UnmapFile(mapping);
+        mappings = mapping->next;
+        delete mapping;
+    }
+    for (int vpn = 0; vpn < (int) numPages; vpn = NextPage(vpn))
+        FreePage(vpn);
+    ASSERT(numResident == 0);
+    pffController->Remove(this);
+    vmLock->Release();
+    delete swapSlots;
+    CloseImage(image);
 }
 
 //----------------------------------------------------------------------
@@ -214,22 +273,684 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	The TLB entries of this address space are tagged with its ASID,
+//	so they stay in the TLB, and are still there if it runs again
+//	before they are replaced.  Just count its TLB hits and misses.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+    if (machine->tlb != NULL)
+        CountTLBUse();
+    runTicks += stats->userTicks - ticksAtSwitch;
+    ticksAtSwitch = stats->userTicks;
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      Tell the machine which address space's pages to use, and which
+//	TLB entries are its own, giving it an ASID first if its old one
+//	was taken back.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
-    machine->pageTable = pageTable;
+    machine->currentSpace = spaceId;
     machine->pageTableSize = numPages;
+    if (machine->tlb != NULL) {
+        if (!HasASID())
+            NewASID();
+        machine->currentASID = asid;
+        hitsAtSwitch = stats->numTLBHits;
+        missesAtSwitch = stats->numTLBMisses;
+    }
+    ticksAtSwitch = stats->userTicks;
+    machine->FlushHostTLB();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::HasASID
+// 	Return TRUE if this address space has an ASID of the current
+//	generation, so that TLB entries tagged with it are its own.
+//----------------------------------------------------------------------
+
+bool AddrSpace::HasASID()
+{
+    return asidGeneration == generation;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::NewASID
+// 	Give this address space the next ASID.  If there are none left,
+//	start a new generation: every entry in the TLB belongs to an
+//	ASID of the old one, so unload them all (on behalf of whoever
+//	had it), and every address space will need a new ASID.
+//----------------------------------------------------------------------
+
+void AddrSpace::NewASID()
+{
+    if (nextASID == NumASIDs) {
+        DEBUG('a', "Out of ASIDs, flushing the TLB\n");
+        for (int i = 0; i < machine->numTLBEntries; i++)
+            if (machine->tlb[i].valid)
+                asidOwners[machine->tlb[i].asid]->
+                                UnloadTLBEntry(&machine->tlb[i]);
+        for (int i = 0; i < NumASIDs; i++)
+            asidOwners[i] = NULL;
+        generation++;
+        nextASID = 0;
+        stats->numTLBFlushes++;
+    }
+    if (asidGeneration != 0)		// lost its entries in a flush
+        tlbFlushes++;
+    asid = nextASID++;
+    asidGeneration = generation;
+    asidOwners[asid] = this;
+    DEBUG('a', "Address space %d gets ASID %d\n", spaceId, asid);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ASIDOwner
+// 	Return the address space the TLB entries tagged "asid" belong
+//	to; there must be one, since an address space unloads its
+//	entries when it is deleted.
+//----------------------------------------------------------------------
+
+AddrSpace *AddrSpace::ASIDOwner(int asid)
+{
+    ASSERT(asid >= 0 && asid < NumASIDs && asidOwners[asid] != NULL);
+    return asidOwners[asid];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindTLBEntry
+// 	Return the TLB entry caching this address space's page "vpn",
+//	whether or not it is running, or NULL if there is none.
+//----------------------------------------------------------------------
+
+TranslationEntry *AddrSpace::FindTLBEntry(int vpn)
+{
+    if (machine->tlb == NULL || !HasASID())
+        return NULL;
+    for (int i = 0; i < machine->numTLBEntries; i++)
+        if (machine->tlb[i].valid && machine->tlb[i].asid == asid
+                && machine->tlb[i].virtualPage == vpn)
+            return &machine->tlb[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UnloadTLB
+// 	Take all of this address space's translations out of the TLB.
+//----------------------------------------------------------------------
+
+void AddrSpace::UnloadTLB()
+{
+    if (machine->tlb == NULL || !HasASID())
+        return;
+    for (int i = 0; i < machine->numTLBEntries; i++)
+        if (machine->tlb[i].valid && machine->tlb[i].asid == asid)
+            UnloadTLBEntry(&machine->tlb[i]);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CountTLBUse
+// 	Add the TLB hits and misses since this address space last started
+//	running, which are all its own, to its totals.
+//----------------------------------------------------------------------
+
+void AddrSpace::CountTLBUse()
+{
+    tlbHits += stats->numTLBHits - hitsAtSwitch;
+    tlbMisses += stats->numTLBMisses - missesAtSwitch;
+    hitsAtSwitch = stats->numTLBHits;
+    missesAtSwitch = stats->numTLBMisses;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CountTLBMiss
+// 	Charge the "ticks" it took to handle a TLB miss, including any
+//	page fault, to this address space and to the system.
+//----------------------------------------------------------------------
+
+void AddrSpace::CountTLBMiss(int ticks)
+{
+    tlbMissTicks += ticks;
+    stats->numTLBMissTicks += ticks;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PrintTLBStats
+// 	Print how well the TLB has worked for this address space, which
+//	must be running: called when its program exits.
+//----------------------------------------------------------------------
+
+void AddrSpace::PrintTLBStats()
+{
+    char who[40];
+
+    ASSERT(machine->currentSpace == spaceId);
+    CountTLBUse();
+    sprintf(who, "TLB of address space %d", spaceId);
+    stats->PrintTLB(who, tlbHits, tlbMisses, tlbMissTicks, tlbFlushes);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::VirtualTime
+// 	Return the # of ticks this address space has run user code for,
+//	counting the time since it last started running, if it is
+//	running now.  The PFF controller measures the time between page
+//	faults with it, so that waiting for the CPU doesn't count.
+//----------------------------------------------------------------------
+
+int AddrSpace::VirtualTime()
+{
+    if (machine->currentSpace == spaceId)
+        return runTicks + stats->userTicks - ticksAtSwitch;
+    return runTicks;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PrintFrameStats
+// 	Print the most frames this address space has had at once, and
+//	how often the PFF controller suspended it: called when its
+//	program exits.
+//----------------------------------------------------------------------
+
+void AddrSpace::PrintFrameStats()
+{
+    printf("Frames of address space %d: at most %d, suspended %d times\n",
+           spaceId, maxResident, numSuspensions);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UnloadTLBEntry
+// 	Take one of this address space's translations out of the TLB.
+//	The hardware only sets the use and dirty bits in the TLB copy,
+//	so merge them into the inverted page table entry first, or page
+//	replacement would lose track of modified pages.
+//----------------------------------------------------------------------
+
+void AddrSpace::UnloadTLBEntry(TranslationEntry *tlbEntry)
+{
+    TranslationEntry *entry =
+        machine->pageTable->Lookup(spaceId, tlbEntry->virtualPage);
+
+    if (entry != NULL) {
+        entry->use = entry->use || tlbEntry->use;
+        entry->dirty = entry->dirty || tlbEntry->dirty;
+    }
+    tlbEntry->valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FaultAround
+// 	Page "vpn" has faulted.  Decide how many pages, starting with it,
+//	to read in together: the following pages are included as long as
+//	they are not in memory and are stored right after it, in the
+//	executable or in swap, so that one read gets them all, or in the
+//	same mapped file.
+//
+//	The window starts at FaultAroundPages.  Each fault just past the
+//	pages the last one read in doubles it, up to MaxFaultAround, so
+//	a program scanning an array sequentially faults less and less
+//	often; any other fault resets it.  A FaultAroundPages of 1 turns
+//	all of this off.
+//----------------------------------------------------------------------
+
+int AddrSpace::FaultAround(int vpn)
+{
+    FileMapping *mapping = FindMapping(vpn);
+    int slot = swapSlots->Get(vpn);
+    int count;
+
+    if (vpn == nextSequential && FaultAroundPages > 1)
+        faultWindow = min(2 * faultWindow, MaxFaultAround);
+    else
+        faultWindow = FaultAroundPages;
+
+    if (mapping != NULL) {
+        for (count = 1; count < faultWindow; count++)
+            if (vpn + count >= mapping->firstPage + mapping->numPages
+                    || machine->pageTable->Lookup(spaceId, vpn + count))
+                break;
+    } else if (ZeroFill(vpn))
+        count = 1;              // nothing to read
+    else {
+        for (count = 1; count < faultWindow; count++) {
+            int next = vpn + count;
+
+            if ((unsigned int) next >= numPages
+                    || machine->pageTable->Lookup(spaceId, next) != NULL)
+                break;
+            if (image->IsText(next) != image->IsText(vpn)
+                    || image->TextFrame(next) != -1)
+                break;          // code pages are mapped on their own
+            if (slot != -1) {
+                if (swapSlots->Get(next) != slot + count)
+                    break;
+            } else if (swapSlots->Get(next) != -1 || next >= firstZeroPage)
+                break;
+        }
+    }
+    nextSequential = vpn + count;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ZeroFill
+// 	Return TRUE if virtual page "vpn" starts out as zeroes: it is
+//	past the code and initialized data, and hasn't been written to
+//	swap yet, nor is it part of a mapped file.
+//----------------------------------------------------------------------
+
+bool AddrSpace::ZeroFill(int vpn)
+{
+    return vpn >= firstZeroPage && swapSlots->Get(vpn) == -1
+            && FindMapping(vpn) == NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadPages
+// 	Fill the physical page frames "frames" with the contents of the
+//	"count" virtual pages starting at "vpn", which FaultAround has
+//	found to be stored together: from swap, if they have been written
+//	back, and otherwise from the code and initialized data segments
+//	of the executable, with zeroes everywhere else.  Uninitialized
+//	data and stack pages are zero-filled on demand, with no I/O at
+//	all -- or nothing at all, if the frame was zeroed ahead of time.
+//
+//	Pages of a mapped file are read from the file's sectors straight
+//	into their frames.
+//----------------------------------------------------------------------
+
+void AddrSpace::LoadPages(int vpn, int *frames, int count)
+{
+    FileMapping *mapping = FindMapping(vpn);
+    int slot = swapSlots->Get(vpn);
+    char *pages;
+
+    if (mapping != NULL) {
+        for (int i = 0; i < count; i++) {
+            DEBUG('M', "Reading mapped vpn %d\n", vpn + i);
+            mapping->file->ReadSectors(
+                    &(machine->mainMemory[frames[i] * PageSize]), PageSize,
+                    (vpn + i - mapping->firstPage) * PageSize);
+            stats->numMappedReads++;
+        }
+        return;
+    }
+
+    if (ZeroFill(vpn)) {
+        ASSERT(count == 1);
+        DEBUG('M', "Zero-filling vpn %d\n", vpn);
+        stats->numZeroFills++;
+        if (coreMap->Frame(frames[0])->zeroed)
+            stats->numPreZeroed++;      // zeroed while the machine idled
+        else
+            coreMap->ZeroFrame(frames[0]);
+        return;
+    }
+
+    if (count == 1)             // read it straight into place
+        pages = &(machine->mainMemory[frames[0] * PageSize]);
+    else
+        pages = new char[count * PageSize];
+    if (slot != -1)
+        swapSpace->ReadPages(slot, count, pages);
+    else
+        image->ReadPages(vpn, count, pages);
+    if (count > 1) {
+        for (int i = 0; i < count; i++)
+            memcpy(&(machine->mainMemory[frames[i] * PageSize]),
+                   &pages[i * PageSize], PageSize);
+        delete [] pages;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MapPage
+// 	Enter virtual page "vpn", which has just been read into "frame",
+//	in the inverted page table, and return the new entry.
+//
+//	A code page is mapped read-only, and the image is told where it
+//	is, so that every other address space running the program can
+//	map the same frame (see MapSharedText).
+//----------------------------------------------------------------------
+
+TranslationEntry *AddrSpace::MapPage(int vpn, int frame)
+{
+    TranslationEntry *entry = machine->pageTable->Insert(spaceId, vpn, frame);
+
+    if (image->IsText(vpn)) {
+        entry->readOnly = TRUE;
+        image->CacheText(vpn, frame);
+        coreMap->Frame(frame)->text = image;
+    }
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MapSharedText
+// 	If "vpn" is a code page that some address space running the same
+//	program has in memory, map the same frame, read-only, and return
+//	the new entry; no I/O is needed.  Otherwise return NULL.
+//----------------------------------------------------------------------
+
+TranslationEntry *AddrSpace::MapSharedText(int vpn)
+{
+    int frame = image->TextFrame(vpn);
+    TranslationEntry *entry;
+
+    if (frame == -1)
+        return NULL;
+    DEBUG('M', "Sharing code page %d in frame %d\n", vpn, frame);
+    entry = machine->pageTable->Insert(spaceId, vpn, frame);
+    entry->readOnly = TRUE;
+    coreMap->Share(frame, this);
+    stats->numTextShared++;
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReserveSlot
+// 	Make sure virtual page "vpn" has a swap slot of its own to be
+//	written back to, giving it one if it doesn't have one yet.  A
+//	page of a mapped file needs none.
+//
+//	"users" is the # of address spaces sharing the page's frame, this
+//	one included; they all keep the page in the same slot.  If still
+//	other address spaces use that slot, which happens after a Fork,
+//	they need what is in it now, so the page gets a new slot.
+//
+//	Returns FALSE if every slot is taken; nothing is changed then.
+//----------------------------------------------------------------------
+
+bool AddrSpace::ReserveSlot(int vpn, int users)
+{
+    int slot = swapSlots->Get(vpn);
+
+    if (FindMapping(vpn) != NULL)
+        return TRUE;
+    if (slot != -1 && swapSpace->NumUsers(slot) <= users)
+        return TRUE;
+    slot = swapSpace->AllocateSlot();
+    if (slot == -1)
+        return FALSE;
+    if (swapSlots->Get(vpn) != -1)
+        swapSpace->FreeSlot(swapSlots->Get(vpn));
+    swapSlots->Set(vpn, slot);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SavePage
+// 	Write virtual page "vpn", which is in frame "frame", back to swap,
+//	and return its slot.  A page of a mapped file is written back to
+//	the file instead, and has no slot (-1).
+//
+//	The caller must have made sure there is a slot for it, with
+//	ReserveSlot; "users" is as there.
+//----------------------------------------------------------------------
+
+int AddrSpace::SavePage(int vpn, int frame, int users)
+{
+    FileMapping *mapping = FindMapping(vpn);
+    int slot;
+
+    if (mapping != NULL) {
+        ASSERT(users == 1);
+        mapping->file->WriteSectors(&(machine->mainMemory[frame * PageSize]),
+                PageSize, (vpn - mapping->firstPage) * PageSize);
+        stats->numMappedWrites++;
+        return -1;
+    }
+
+    if (!ReserveSlot(vpn, users))
+        ASSERT(FALSE);                  // the caller's job
+    slot = swapSlots->Get(vpn);
+    swapSpace->WritePage(slot, &(machine->mainMemory[frame * PageSize]));
+    return slot;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ShareSlot
+// 	Virtual page "vpn" has been written back to swap slot "slot" by
+//	another address space sharing its frame; keep it there, giving up
+//	the slot it had before.
+//----------------------------------------------------------------------
+
+void AddrSpace::ShareSlot(int vpn, int slot)
+{
+    int old = swapSlots->Get(vpn);
+
+    if (old == slot)
+        return;
+    if (old != -1)
+        swapSpace->FreeSlot(old);
+    swapSpace->ShareSlot(slot);
+    swapSlots->Set(vpn, slot);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::InUse
+// 	Return TRUE if virtual page "vpn" is part of the program's memory:
+//	its code and data, its heap, a mapped file, or its stack.  A page
+//	below the stack, but no more than MaxStackSize below the top of
+//	the address space, becomes part of the stack now; the stack grows
+//	down to it.
+//----------------------------------------------------------------------
+
+bool AddrSpace::InUse(int vpn)
+{
+    if (vpn < 0 || vpn >= (int) numPages)
+        return FALSE;
+    if (vpn < divRoundUp(brk, PageSize) || vpn >= stackPage
+            || FindMapping(vpn) != NULL)
+        return TRUE;
+    if (vpn < stackLimit)
+        return FALSE;
+    DEBUG('a', "Growing the stack of address space %d down to page %d\n",
+                                        spaceId, vpn);
+    stackPage = vpn;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::NextPage
+// 	Return the page after "vpn" that is part of the program's memory,
+//	skipping the unused pages between the heap and the stack, or
+//	numPages if there are none.  Used to go through the pages in use
+//	without looking at every page of the address space.
+//----------------------------------------------------------------------
+
+int AddrSpace::NextPage(int vpn)
+{
+    vpn++;
+    if (vpn >= divRoundUp(brk, PageSize) && vpn < stackPage) {
+        int next = stackPage;
+
+        for (FileMapping *m = mappings; m != NULL; m = m->next)
+            if (m->firstPage + m->numPages > vpn)
+                next = min(next, max(vpn, m->firstPage));
+        vpn = next;
+    }
+    return vpn;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Sbrk
+// 	Move the program break -- the end of the heap -- by "increment"
+//	bytes, and return where it was, or -1 if the heap would start
+//	before heapStart or run into the mapped files, or the room the
+//	stack may grow into.
+//
+//	New heap pages are zero-filled when they are first touched, like
+//	uninitialized data.  Pages the heap shrinks away from are given
+//	up, so they are zero again if it grows back over them.
+//----------------------------------------------------------------------
+
+int AddrSpace::Sbrk(int increment)
+{
+    int old = brk;
+    int newBrk = brk + increment;
+
+    if (newBrk < heapStart || divRoundUp(newBrk, PageSize) > mmapBase)
+        return -1;
+    DEBUG('a', "Moving the break of address space %d from %d to %d\n",
+                                        spaceId, brk, newBrk);
+    if (newBrk < brk) {
+        vmLock->Acquire();
+        for (int vpn = divRoundUp(newBrk, PageSize);
+                        vpn < divRoundUp(brk, PageSize); vpn++)
+            FreePage(vpn);
+        machine->FlushHostTLB();
+        vmLock->Release();
+    }
+    brk = newBrk;
+    return old;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FreePage
+// 	Give up virtual page "vpn": drop it from the TLB and the inverted
+//	page table, and give its frame back to the core map and its slot
+//	back to the swap area, unless other address spaces made by Fork
+//	still share them.  vmLock must be held.
+//----------------------------------------------------------------------
+
+void AddrSpace::FreePage(int vpn)
+{
+    TranslationEntry *entry = machine->pageTable->Lookup(spaceId, vpn);
+    TranslationEntry *tlbEntry = FindTLBEntry(vpn);
+    int slot = swapSlots->Get(vpn);
+
+    if (tlbEntry != NULL)
+        tlbEntry->valid = FALSE;
+    if (entry != NULL) {
+        int frame = entry->physicalPage;
+
+        if (coreMap->Frame(frame)->refCount > 1)
+            coreMap->Unshare(frame, this);
+        else
+            coreMap->Free(frame);
+        machine->pageTable->Remove(spaceId, vpn);
+    }
+    if (slot != -1) {
+        swapSpace->FreeSlot(slot);
+        swapSlots->Set(vpn, -1);
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Mmap
+// 	Map the first "length" bytes of "file" into memory, and return
+//	the address of the first one, or -1 if there is no room for them
+//	between the heap and the files mapped already.
+//
+//	Nothing is read now: each page is read straight from the file's
+//	sectors when it is first touched, and if it is changed, written
+//	back to them when it is replaced, or when the file is unmapped.
+//	The file doesn't grow; what is mapped past its end reads as
+//	zeroes, and changes to it are lost.  Pages are read and written
+//	whole sectors at a time, so they must be a whole number of
+//	sectors.
+//----------------------------------------------------------------------
+
+int AddrSpace::Mmap(OpenFile *file, int length)
+{
+    FileMapping *mapping;
+    int count = divRoundUp(length, PageSize);
+
+    if (file == NULL || length <= 0 || PageSize % SectorSize != 0
+            || mmapBase - count < divRoundUp(brk, PageSize))
+        return -1;
+    mapping = new FileMapping;
+    mapping->file = file;
+    mapping->numPages = count;
+    mapping->firstPage = mmapBase - count;
+    mapping->next = mappings;
+    mappings = mapping;
+    mmapBase = mapping->firstPage;
+    DEBUG('a', "Mapping %d bytes of a file at page %d of address space %d\n",
+                                        length, mmapBase, spaceId);
+    return mmapBase * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Munmap
+// 	Unmap the file that Mmap mapped at address "addr", writing its
+//	pages that were changed back to it.  Return 0, or -1 if no file
+//	is mapped there.
+//----------------------------------------------------------------------
+
+int AddrSpace::Munmap(int addr)
+{
+    FileMapping **link = &mappings;
+    FileMapping *mapping;
+
+    while (*link != NULL && (*link)->firstPage * PageSize != addr)
+        link = &(*link)->next;
+    if (*link == NULL)
+        return -1;
+    mapping = *link;
+    DEBUG('a', "Unmapping page %d of address space %d\n",
+                                        mapping->firstPage, spaceId);
+    vmLock->Acquire();
+    UnmapFile(mapping);
+    machine->FlushHostTLB();
+    *link = mapping->next;
+    vmLock->Release();
+    delete mapping;
+
+    mmapBase = stackLimit;		// the heap may use what is left
+    for (mapping = mappings; mapping != NULL; mapping = mapping->next)
+        mmapBase = min(mmapBase, mapping->firstPage);
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindMapping
+// 	Return the mapped file that page "vpn" belongs to, or NULL if it
+//	isn't part of one.
+//----------------------------------------------------------------------
+
+FileMapping *AddrSpace::FindMapping(int vpn)
+{
+    if (vpn < mmapBase || vpn >= stackLimit)
+        return NULL;
+    for (FileMapping *m = mappings; m != NULL; m = m->next)
+        if (vpn >= m->firstPage && vpn < m->firstPage + m->numPages)
+            return m;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UnmapFile
+// 	Give up the pages of "mapping", first writing the ones in memory
+//	that were changed back to the file.  vmLock must be held.
+//----------------------------------------------------------------------
+
+void AddrSpace::UnmapFile(FileMapping *mapping)
+{
+    for (int i = 0; i < mapping->numPages; i++) {
+        int vpn = mapping->firstPage + i;
+        TranslationEntry *entry = machine->pageTable->Lookup(spaceId, vpn);
+        TranslationEntry *tlbEntry = FindTLBEntry(vpn);
+
+        if (tlbEntry != NULL)           // collect its dirty bit
+            UnloadTLBEntry(tlbEntry);
+        if (entry != NULL && (entry->dirty
+                    || coreMap->Frame(entry->physicalPage)->dirty)) {
+            FrameInfo *info = coreMap->Frame(entry->physicalPage);
+
+            info->pinned = TRUE;
+            SavePage(vpn, entry->physicalPage, info->refCount);
+            info->pinned = FALSE;
+        }
+        FreePage(vpn);
+    }
 }
@@ -15,27 +15,168 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "image.h"
+#include "pagemap.h"
 
-#define UserStackSize		1024 	// increase this as necessary!
+#define UserSpaceSize		(1024 * 1024)	// bytes of virtual memory
+						// each program can address
+#define UserStackSize		1024 	// the stack a program starts with
+#define MaxStackSize		(16 * 1024)	// and the most it can grow to
+
+#define DefaultFaultAround	2	// pages read in on a fault, at first
+#define MaxFaultAround		16	// most pages read in on a fault
+extern int FaultAroundPages;		// set with -fa
+
+// The following class defines a file mapped into an address space with
+// Mmap: its bytes, from the start of the file on, are the "numPages"
+// virtual pages from "firstPage" on.
+
+class FileMapping {
+  public:
+    OpenFile *file;			// the file
+    int firstPage;			// where it is mapped
+    int numPages;
+    FileMapping *next;			// the next one, or NULL
+};
 
 class AddrSpace {
   public:
     AddrSpace(OpenFile *executable);	// Create an address space,
 					// initializing it with the program
-					// stored in the file "executable"
+					// stored in the file "executable",
+					// which it takes over
+    AddrSpace(AddrSpace *parent);	// Create a copy of "parent", sharing
+					// its pages until either one
+					// writes to them
     ~AddrSpace();			// De-allocate an address space
 
+    bool Fits();			// Is there room for the program?
+
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
+    void UnloadTLBEntry(TranslationEntry *tlbEntry);
+					// Copy a TLB entry's use and dirty
+					// bits back to the page table, and
+					// invalidate it
+    TranslationEntry *FindTLBEntry(int vpn);
+					// The TLB entry caching page "vpn"
+					// of this space, or NULL
+    void UnloadTLB();			// Unload all of this space's entries
+    static AddrSpace *ASIDOwner(int asid);
+					// The space TLB entries tagged
+					// "asid" belong to
+    void CountTLBMiss(int ticks);	// A TLB miss of this space took
+					// "ticks" to handle
+    void PrintTLBStats();		// Print how well the TLB worked
+					// for this space
+
+    int getSpaceId() { return spaceId; }	// this space's # in the
+					// machine's inverted page table
+
+    bool ZeroFill(int vpn);		// Does page "vpn" start out as
+					// zeroes, with nothing to read?
+    int FaultAround(int vpn);		// How many pages to read in,
+					// starting at page "vpn"?
+    void LoadPages(int vpn, int *frames, int count);
+					// Read "count" pages, starting at
+					// "vpn", into "frames"
+    TranslationEntry *MapPage(int vpn, int frame);
+					// Map page "vpn", just read into
+					// "frame"
+    TranslationEntry *MapSharedText(int vpn);
+					// Map code page "vpn", if another
+					// address space has it in memory
+    bool ReserveSlot(int vpn, int users);
+					// Make sure page "vpn", used by
+					// "users" address spaces, has a swap
+					// slot to be written to; FALSE if
+					// swap is full
+    int SavePage(int vpn, int frame, int users);
+					// Write page "vpn", used by "users"
+					// address spaces, from "frame" back
+					// to swap; returns the slot
+    void ShareSlot(int vpn, int slot);	// Keep page "vpn" in swap slot
+					// "slot", which another address
+					// space has written it to
+
+    bool InUse(int vpn);		// Is page "vpn" part of the program's
+					// memory?  Grows the stack down to it
+					// if it can
+    int Sbrk(int increment);		// Move the end of the heap by
+					// "increment" bytes; returns the old
+					// end, or -1
+    int Mmap(OpenFile *file, int length);
+					// Map "length" bytes of "file" into
+					// memory; returns where, or -1
+    int Munmap(int addr);		// Unmap the file mapped at "addr",
+					// writing back what was changed
+
+    int VirtualTime();			// User ticks this space has run for
+    void GainFrame()			// It owns one more frame, or one
+	{ if (++numResident > maxResident) maxResident = numResident; }
+    void LoseFrame() { numResident--; }	// less (see CoreMap)
+    void PrintFrameStats();		// Print how many frames it had
+
+    int numResident;			// # of frames this space owns
+    int lastFault;			// its virtual time at its last page
+					// fault, for the PFF controller
+    bool suspended;			// taken out of memory by it?
+    int suspendedAt;			// when, in total ticks,
+    int suspendedFrames;		// and how many frames it had then
+    int numSuspensions;			// how many times it was suspended
+    AddrSpace *nextSpace;		// next on the controller's list
+
   private:
-    TranslationEntry *pageTable;	// Assume linear page table translation
-					// for now!
+    int spaceId;			// Unique # naming this address space
+					// in the inverted page table
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    PageMap *swapSlots;			// swap slot holding each page, or
+					// -1 if it has none yet
+    int heapStart;			// the heap is the bytes from here
+    int brk;				// up to here, the program break
+    int stackPage;			// the stack is the pages from here
+					// up to the end of the address space
+    int stackLimit;			// it may grow down to this page
+    FileMapping *mappings;		// the files mapped with Mmap, which
+    int mmapBase;			// are below stackLimit, down to here
+    ExecImage *image;			// where unmodified pages come from
+    int firstZeroPage;			// pages from here on start out
+					// as zeroes (uninitialized data
+					// and stack)
+    int faultWindow;			// most pages to read in on a fault
+    int nextSequential;			// page just past the last ones
+					// read in
+    int asid;				// tags this space's TLB entries,
+    int asidGeneration;			// as long as this is the current
+					// generation of ASIDs
+
+    bool HasASID();			// Is "asid" still ours?
+    void NewASID();			// Take the next free ASID
+
+    int tlbHits, tlbMisses;		// this space's TLB hits and misses,
+    int tlbMissTicks;			// the time spent on the misses,
+    int tlbFlushes;			// and how often its entries were
+					// flushed
+    int hitsAtSwitch, missesAtSwitch;	// the system's hits and misses when
+					// it last started running
+    int runTicks;			// user ticks run, up to then,
+    int ticksAtSwitch;			// and the system's user ticks then
+    int maxResident;			// most frames it has owned at once
+    void CountTLBUse();			// Add in the hits and misses since
+					// then
+
+    int NextPage(int vpn);		// The page in use after "vpn"
+    void FreePage(int vpn);		// Give back page "vpn"'s frame and
+					// swap slot
+    FileMapping *FindMapping(int vpn);	// The mapping page "vpn" is in, or
+					// NULL
+    void UnmapFile(FileMapping *mapping);
+					// Write back and give up its pages
 };
 
 #endif // ADDRSPACE_H
@@ -0,0 +1,331 @@
+// coremap.cc
+//	Routines to keep track of the owners of physical page frames.
+
+#include "copyright.h"
+#include "system.h"
+#include "coremap.h"
+#include "addrspace.h"
+#include <string.h>
+
+//----------------------------------------------------------------------
+// CoreMap::CoreMap
+// 	Initialize a core map, with every frame free.
+//
+//	"size" is the number of physical page frames.
+//	"policyName" is the replacement policy to use (see replace.h).
+//----------------------------------------------------------------------
+
+CoreMap::CoreMap(int size, const char *policyName)
+{
+    numFrames = size;
+    frames = new FrameInfo[numFrames];
+    freeFrames = new int[numFrames];
+    for (int i = 0; i < numFrames; i++) {
+	frames[i].owner = NULL;
+	frames[i].virtualPage = -1;
+	frames[i].pinned = FALSE;
+	frames[i].dirty = FALSE;
+	frames[i].refCount = 0;
+	frames[i].sharers = NULL;
+	frames[i].text = NULL;
+	frames[i].zeroed = FALSE;
+	freeFrames[i] = numFrames - 1 - i;	// hand out frame 0 first
+    }
+    numFree = numFrames;
+    zeroFrames = new int[numFrames];
+    numZeroed = 0;
+    zeroReserve = max(numFrames / 8, 1);
+    policy = NewReplacementPolicy(policyName, this, numFrames);
+    if (policy == NULL) {
+	printf("Unknown page replacement policy %s\n", policyName);
+	ASSERT(FALSE);
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::~CoreMap
+// 	De-allocate a core map.
+//----------------------------------------------------------------------
+
+CoreMap::~CoreMap()
+{
+    delete [] frames;
+    delete [] freeFrames;
+    delete [] zeroFrames;
+    delete policy;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Allocate
+// 	Take a frame off the free list, to hold virtual page "vpn" of
+//	address space "owner", and tell the replacement policy.
+//
+//	If "zero" is set, the page starts out as zeroes, so a frame
+//	zeroed ahead of time is taken, if there is one; otherwise those
+//	are saved for such pages, as long as other frames are free.  The
+//	frame's "zeroed" field says which kind it got.
+//
+//	The frame is pinned, since the caller is about to fill it in;
+//	the caller unpins it when the page is ready.
+//
+//	Returns the frame #, or -1 if no frames are free.
+//----------------------------------------------------------------------
+
+int
+CoreMap::Allocate(AddrSpace *owner, int vpn, bool zero)
+{
+    int frame;
+
+    if (numZeroed > 0 && (zero || numFree == 0)) {
+	frame = zeroFrames[--numZeroed];
+	frames[frame].zeroed = TRUE;
+    } else if (numFree > 0) {
+	frame = freeFrames[--numFree];
+	frames[frame].zeroed = FALSE;
+    } else
+	return -1;
+    frames[frame].owner = owner;
+    frames[frame].virtualPage = vpn;
+    frames[frame].pinned = TRUE;
+    frames[frame].dirty = FALSE;
+    frames[frame].refCount = 1;
+    frames[frame].text = NULL;
+    owner->GainFrame();
+    policy->Allocated(frame);
+    DEBUG('M', "Frame %d allocated to vpn %d\n", frame, vpn);
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Free
+// 	Give a frame back, when its page is replaced or the last address
+//	space using it goes away.  If it held a code page, its image must
+//	forget about it.
+//
+//	"frame" is the # of the frame, which must be in use.
+//----------------------------------------------------------------------
+
+void
+CoreMap::Free(int frame)
+{
+    FrameSharer *sharer;
+
+    ASSERT((frame >= 0) && (frame < numFrames));
+    ASSERT(frames[frame].owner != NULL);
+    DEBUG('M', "Frame %d freed\n", frame);
+
+    policy->Freed(frame);
+    while (frames[frame].sharers != NULL) {
+	sharer = frames[frame].sharers;
+	frames[frame].sharers = sharer->next;
+	delete sharer;
+    }
+    if (frames[frame].text != NULL)
+	frames[frame].text->UncacheText(frames[frame].virtualPage);
+    frames[frame].owner->LoseFrame();
+    frames[frame].text = NULL;
+    frames[frame].owner = NULL;
+    frames[frame].virtualPage = -1;
+    frames[frame].pinned = FALSE;
+    frames[frame].dirty = FALSE;
+    frames[frame].refCount = 0;
+    frames[frame].zeroed = FALSE;
+    freeFrames[numFree++] = frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ZeroFrame
+// 	Fill "frame" with zeroes, a page at a time.
+//----------------------------------------------------------------------
+
+void
+CoreMap::ZeroFrame(int frame)
+{
+    ASSERT((frame >= 0) && (frame < numFrames));
+    memset(&(machine->mainMemory[frame * PageSize]), 0, PageSize);
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ZeroFreeFrame
+// 	Called while the machine is idle: zero one of the free frames
+//	that aren't zeroed yet, and move it to the zeroed ones, unless
+//	there are "zeroReserve" of them already.  Returns FALSE if there
+//	was nothing to do.
+//
+//	Nobody uses a free frame, so it doesn't matter what paging is
+//	going on meanwhile; interrupts are off, so no thread can take a
+//	frame at the same time.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::ZeroFreeFrame()
+{
+    int frame;
+
+    if (numZeroed >= zeroReserve || numFree == 0)
+	return FALSE;
+    frame = freeFrames[--numFree];
+    ZeroFrame(frame);
+    zeroFrames[numZeroed++] = frame;
+    stats->numFramesZeroed++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Share
+// 	Record that address space "space" maps "frame" too, at the same
+//	virtual page as its owner.
+//----------------------------------------------------------------------
+
+void
+CoreMap::Share(int frame, AddrSpace *space)
+{
+    FrameSharer *sharer = new FrameSharer;
+
+    ASSERT(frames[frame].owner != NULL);
+    sharer->space = space;
+    sharer->next = frames[frame].sharers;
+    frames[frame].sharers = sharer;
+    frames[frame].refCount++;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Unshare
+// 	Record that address space "space" no longer maps "frame", which
+//	others still map.  If "space" was the owner, one of the others
+//	takes over, and counts the frame as its own.
+//----------------------------------------------------------------------
+
+void
+CoreMap::Unshare(int frame, AddrSpace *space)
+{
+    FrameInfo *info = &frames[frame];
+    FrameSharer **link = &info->sharers;
+    FrameSharer *sharer;
+
+    ASSERT(info->refCount > 1 && info->sharers != NULL);
+    if (info->owner == space) {
+	info->owner = info->sharers->space;	// take the first one's place
+	space->LoseFrame();
+	info->owner->GainFrame();
+    } else
+	while ((*link)->space != space) {
+	    link = &(*link)->next;
+	    ASSERT(*link != NULL);
+	}
+    sharer = *link;
+    *link = sharer->next;
+    delete sharer;
+    info->refCount--;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FindVictim
+// 	Ask the replacement policy for a frame whose page can be replaced.
+//
+//	The policy may have cleared use bits along the way, which only
+//	get set again by a Translate, so empty the host translation
+//	cache, whose hits skip Translate.
+//
+//	Returns -1 if every frame in use is pinned.
+//----------------------------------------------------------------------
+
+int
+CoreMap::FindVictim()
+{
+    int frame = policy->FindVictim();
+
+    machine->FlushHostTLB();
+    DEBUG('M', "Policy %s chose frame %d\n", policy->Name(), frame);
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Replaceable
+// 	Return TRUE if "frame" holds a page and isn't pinned.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::Replaceable(int frame)
+{
+    return (frames[frame].owner != NULL) && !frames[frame].pinned;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FindEntry
+// 	Find the inverted page table entry mapping "frame" for its owner,
+//	and the TLB entry caching it (or NULL).
+//----------------------------------------------------------------------
+
+TranslationEntry *
+CoreMap::FindEntry(int frame, TranslationEntry **tlbEntry)
+{
+    FrameInfo *info = &frames[frame];
+
+    *tlbEntry = info->owner->FindTLBEntry(info->virtualPage);
+    return machine->pageTable->Lookup(info->owner->getSpaceId(),
+					info->virtualPage);
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Referenced
+// 	Return TRUE if the page in "frame" has been used, by any of the
+//	address spaces mapping it, since the last time we looked, and
+//	clear their use bits for next time.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::Referenced(int frame)
+{
+    FrameInfo *info = &frames[frame];
+    bool used = Referenced(info->owner, info->virtualPage);
+
+    for (FrameSharer *s = info->sharers; s != NULL; s = s->next)
+	if (Referenced(s->space, info->virtualPage))
+	    used = TRUE;
+    return used;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Referenced
+// 	Return TRUE if address space "space" has used its page "vpn"
+//	since the last time we looked, and clear the use bit.
+//
+//	The hardware sets the use bit in the TLB's copy of the entry,
+//	if there is one, so check (and clear) both copies.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::Referenced(AddrSpace *space, int vpn)
+{
+    TranslationEntry *tlbEntry = space->FindTLBEntry(vpn);
+    TranslationEntry *entry =
+		machine->pageTable->Lookup(space->getSpaceId(), vpn);
+    bool used = FALSE;
+
+    if (entry != NULL) {
+	used = entry->use;
+	entry->use = FALSE;
+    }
+    if (tlbEntry != NULL) {
+	used = used || tlbEntry->use;
+	tlbEntry->use = FALSE;
+    }
+    return used;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::IsDirty
+// 	Return TRUE if the page in "frame" would have to be written back
+//	before the frame could be reused.
+//----------------------------------------------------------------------
+
+bool
+CoreMap::IsDirty(int frame)
+{
+    TranslationEntry *tlbEntry;
+    TranslationEntry *entry = FindEntry(frame, &tlbEntry);
+
+    return frames[frame].dirty || (entry != NULL && entry->dirty)
+		|| (tlbEntry != NULL && tlbEntry->dirty);
+}
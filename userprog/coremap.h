@@ -0,0 +1,120 @@
+// coremap.h
+//	Data structures to keep track of physical page frames: which
+//	address space and virtual page each frame holds, and which
+//	frames are free.
+//
+//	Free frames are kept on a stack, so allocating and freeing a
+//	frame take constant time.  Which frame to replace when none is
+//	free is up to a ReplacementPolicy (see replace.h).
+//
+//	Some free frames are zeroed ahead of time, while the machine is
+//	idle, and kept on a stack of their own, so that a page fault on
+//	a page that starts out as zeroes (uninitialized data, heap or
+//	stack) only has to map one.  Other pages get the frames that
+//	aren't zeroed, as long as there are any.
+//
+//	After a Fork, parent and child map the same frames, read-only,
+//	until one of them writes (copy-on-write); and every address space
+//	running a program maps the same frames for its code (see image.h).
+//	A frame then has more than one user: its owner, and a list of the
+//	other address spaces sharing it, all at the same virtual page.
+//	Each address space keeps count of the frames it owns, its
+//	resident set, which the PFF controller goes by (see pff.h).
+
+#ifndef COREMAP_H
+#define COREMAP_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "replace.h"
+#include "translate.h"
+
+class AddrSpace;
+class ExecImage;
+
+// The following class defines one more address space sharing a frame.
+
+class FrameSharer {
+  public:
+    AddrSpace *space;		// the address space
+    FrameSharer *next;		// the next one, or NULL
+};
+
+// The following class defines the core map's record of one physical
+// page frame.
+
+class FrameInfo {
+  public:
+    AddrSpace *owner;		// address space using the frame, or
+				// NULL if the frame is free
+    int virtualPage;		// which of the owner's pages is in it
+    bool pinned;		// if set, the frame must not be replaced
+				// (e.g., a page is being read into it)
+    bool dirty;			// if set, the frame holds changes that
+				// aren't in the page's backing store yet
+    int refCount;		// # of address spaces mapping the frame
+    FrameSharer *sharers;	// the ones besides the owner
+    ExecImage *text;		// if set, the frame holds a code page
+				// of this image, which knows it's here
+    bool zeroed;		// if set, the frame was zeroed ahead of
+				// time, and nothing has been put in it
+};
+
+// The following class defines the core map: one FrameInfo for each
+// physical page frame.
+
+class CoreMap {
+  public:
+    CoreMap(int size, const char *policyName);
+				// Initialize a core map, with every
+				// frame free, replacing pages with
+				// the policy called "policyName"
+    ~CoreMap();			// De-allocate the core map
+
+    int Allocate(AddrSpace *owner, int vpn, bool zero);
+				// Take a free frame for page "vpn" of
+				// "owner", a zeroed one if "zero" is
+				// set and there is one, and return its
+				// #; the frame starts out pinned.
+				// Return -1 if no frame is free.
+    void Free(int frame);	// Put a frame back on the free list
+    void ZeroFrame(int frame);	// Fill a frame with zeroes
+    bool ZeroFreeFrame();	// Zero one more free frame ahead of
+				// time, if the reserve isn't full
+    void Share(int frame, AddrSpace *space);
+				// Let "space" map "frame" too
+    void Unshare(int frame, AddrSpace *space);
+				// "space" no longer maps "frame",
+				// which others still do
+    int FindVictim();		// Return the # of a frame to replace,
+				// or -1 if every frame is pinned
+
+    bool Replaceable(int frame);	// Is "frame" in use and unpinned?
+    bool Referenced(int frame);	// Has "frame" been used since the last
+				// call?  Clears its use bit.
+    bool IsDirty(int frame);	// Has "frame" been modified since its
+				// page was read in?
+
+    FrameInfo *Frame(int frame) { return &frames[frame]; }
+    int NumFree() { return numFree + numZeroed; }
+    const char *PolicyName() { return policy->Name(); }
+
+  private:
+    FrameInfo *frames;		// what each frame holds
+    int numFrames;		// # of physical page frames
+    int *freeFrames;		// stack of the #'s of the free frames
+    int numFree;		// # of frames on the stack
+    int *zeroFrames;		// and of the free frames zeroed
+    int numZeroed;		// ahead of time
+    int zeroReserve;		// how many to keep zeroed
+    ReplacementPolicy *policy;	// chooses the frame to replace
+
+    bool Referenced(AddrSpace *space, int vpn);
+				// Has "space" used page "vpn" since
+				// the last call?
+    TranslationEntry *FindEntry(int frame, TranslationEntry **tlbEntry);
+				// The page table (and TLB) entries
+				// mapping "frame" for its owner
+};
+
+#endif // COREMAP_H
@@ -0,0 +1,289 @@
+// cpool.cc
+//	Routines to manage the compressed pool, and to compress and
+//	uncompress pages.
+
+#include "copyright.h"
+#include "system.h"
+#include "cpool.h"
+#include <string.h>
+
+int PoolBudgetPages = 0;
+
+//----------------------------------------------------------------------
+// PutNumber, GetNumber
+// 	Write the number "n" at "out", 7 bits to a byte, low bits first,
+//	with the top bit of each byte set if more follow; and read one
+//	back.  Return the # of bytes written or read.
+//----------------------------------------------------------------------
+
+static int
+PutNumber(char *out, unsigned int n)
+{
+    int i = 0;
+
+    while (n >= 0x80) {
+	out[i++] = (char) (n | 0x80);
+	n >>= 7;
+    }
+    out[i++] = (char) n;
+    return i;
+}
+
+static int
+GetNumber(char *in, unsigned int *n)
+{
+    int i = 0, shift = 0;
+
+    *n = 0;
+    do {
+	*n |= (unsigned int) (in[i] & 0x7f) << shift;
+	shift += 7;
+    } while (in[i++] & 0x80);
+    return i;
+}
+
+//----------------------------------------------------------------------
+// Compress
+// 	Compress the "numWords" words at "words" into "out", as runs of
+//	equal differences between consecutive words: for each run, its
+//	length and the difference, the difference folded so that small
+//	negative ones are small numbers too.
+//
+//	Returns the # of bytes used, or -1 if that would be more than
+//	"max".  "out" must have room for "max" bytes plus two numbers.
+//----------------------------------------------------------------------
+
+static int
+Compress(unsigned int *words, int numWords, char *out, int max)
+{
+    unsigned int prev = 0;
+    int size = 0;
+
+    for (int i = 0; i < numWords; ) {
+	unsigned int diff = words[i] - prev;
+	int run = 1;
+
+	while (i + run < numWords && words[i + run] - words[i + run - 1] == diff)
+	    run++;
+	size += PutNumber(out + size, run);
+	size += PutNumber(out + size, (diff << 1) ^ -(diff >> 31));
+	if (size > max)
+	    return -1;
+	prev = words[i + run - 1];
+	i += run;
+    }
+    return size;
+}
+
+//----------------------------------------------------------------------
+// Uncompress
+// 	Undo Compress: fill the "numWords" words at "words" from the
+//	"size" bytes at "in".
+//----------------------------------------------------------------------
+
+static void
+Uncompress(char *in, int size, unsigned int *words, int numWords)
+{
+    unsigned int prev = 0, run, folded, diff;
+    int i = 0, pos = 0;
+
+    while (pos < size) {
+	pos += GetNumber(in + pos, &run);
+	pos += GetNumber(in + pos, &folded);
+	diff = (folded >> 1) ^ -(folded & 1);
+	for (; run > 0; run--) {
+	    ASSERT(i < numWords);
+	    prev += diff;
+	    words[i++] = prev;
+	}
+    }
+    ASSERT(i == numWords);
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::CompressedPool
+// 	Initialize an empty pool, for the pages of swap slots 0 to
+//	"size" - 1, which may hold about "maxBytes" bytes.
+//----------------------------------------------------------------------
+
+CompressedPool::CompressedPool(int size, int maxBytes)
+{
+    numSlots = size;
+    budget = maxBytes;
+    bytes = 0;
+    newest = NULL;
+    entries = new PoolEntry *[numSlots];
+    for (int i = 0; i < numSlots; i++)
+	entries[i] = NULL;
+}
+
+CompressedPool::~CompressedPool()
+{
+    for (int i = 0; i < numSlots; i++)
+	Remove(i);
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Store
+// 	Compress the page at "page", and keep it for swap slot "slot",
+//	in place of whatever was kept for it before, as the most recently
+//	used page.  The pool may be over its budget afterwards; it is up
+//	to the caller to spill pages until it isn't.
+//
+//	A page that doesn't compress to under 3/4 of its size is not
+//	kept; return FALSE then.
+//----------------------------------------------------------------------
+
+bool
+CompressedPool::Store(int slot, char *page)
+{
+    unsigned int *words = (unsigned int *) page;
+    int numWords = PageSize / sizeof(unsigned int);
+    PoolEntry *entry;
+    char *buffer;
+    int size, i;
+
+    ASSERT(slot >= 0 && slot < numSlots);
+    Remove(slot);
+    for (i = 1; i < numWords; i++)
+	if (words[i] != words[0])
+	    break;
+    if (i == numWords) {		// the same word all over
+	entry = new PoolEntry;
+	entry->size = 0;
+	entry->data = NULL;
+	entry->fill = words[0];
+	stats->numPoolSameFilled++;
+    } else {
+	buffer = new char[PageSize];
+	size = Compress(words, numWords, buffer, PageSize * 3 / 4 - 10);
+	if (size == -1) {
+	    delete [] buffer;
+	    stats->numPoolRejects++;
+	    return FALSE;
+	}
+	entry = new PoolEntry;
+	entry->size = size;
+	entry->data = new char[size];
+	memcpy(entry->data, buffer, size);
+	delete [] buffer;
+    }
+    DEBUG('M', "Pool stores slot %d in %d bytes\n", slot, entry->size);
+    entry->slot = slot;
+    entry->older = entry->newer = entry;
+    entries[slot] = entry;
+    Touch(entry);
+    bytes += entry->size + PoolEntryBytes;
+    stats->numPoolStores++;
+    stats->numPoolBytesIn += PageSize;
+    stats->numPoolBytesOut += entry->size + PoolEntryBytes;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Load
+// 	Uncompress the page kept for swap slot "slot" into "into", and
+//	make it the most recently used.  The pool keeps it: the page may
+//	be replaced again without being modified, and then isn't written
+//	back anywhere.
+//
+//	Returns FALSE if no page is kept for "slot".
+//----------------------------------------------------------------------
+
+bool
+CompressedPool::Load(int slot, char *into)
+{
+    PoolEntry *entry = entries[slot];
+    unsigned int *words = (unsigned int *) into;
+    int numWords = PageSize / sizeof(unsigned int);
+
+    if (entry == NULL)
+	return FALSE;
+    DEBUG('M', "Pool loads slot %d\n", slot);
+    if (entry->data == NULL)
+	for (int i = 0; i < numWords; i++)
+	    words[i] = entry->fill;
+    else
+	Uncompress(entry->data, entry->size, words, numWords);
+    Touch(entry);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Remove
+// 	Throw away the page kept for swap slot "slot", if there is one:
+//	the slot has been freed, or the page is somewhere else now.
+//----------------------------------------------------------------------
+
+void
+CompressedPool::Remove(int slot)
+{
+    PoolEntry *entry = entries[slot];
+
+    if (entry == NULL)
+	return;
+    Unlink(entry);
+    bytes -= entry->size + PoolEntryBytes;
+    entries[slot] = NULL;
+    if (entry->data != NULL)
+	delete [] entry->data;
+    delete entry;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Oldest
+// 	Return the slot of the least recently used page in the pool, the
+//	next to spill, or -1 if the pool is empty.
+//----------------------------------------------------------------------
+
+int
+CompressedPool::Oldest()
+{
+    if (newest == NULL)
+	return -1;
+    return newest->newer->slot;		// the list is circular
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Touch
+// 	Make "entry" the most recently used page.
+//----------------------------------------------------------------------
+
+void
+CompressedPool::Touch(PoolEntry *entry)
+{
+    if (entry == newest)
+	return;
+    if (entry->older != entry)		// on the list; not a new one
+	Unlink(entry);
+    if (newest == NULL)
+	entry->older = entry->newer = entry;
+    else {
+	entry->older = newest;
+	entry->newer = newest->newer;
+	newest->newer->older = entry;
+	newest->newer = entry;
+    }
+    newest = entry;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Unlink
+// 	Take "entry" off the list of pages, oldest to newest.  An entry
+//	that is on no list points to itself.
+//----------------------------------------------------------------------
+
+void
+CompressedPool::Unlink(PoolEntry *entry)
+{
+    if (entry->older == entry)		// the only one
+	newest = NULL;
+    else {
+	if (entry == newest)
+	    newest = entry->older;
+	entry->older->newer = entry->newer;
+	entry->newer->older = entry->older;
+    }
+    entry->older = entry->newer = entry;
+}
@@ -0,0 +1,80 @@
+// cpool.h
+//	Data structures for the compressed pool: a cache, in kernel
+//	memory, of pages written to swap, kept compressed, so that most
+//	page-outs and the page faults that bring the pages back need no
+//	disk I/O at all.
+//
+//	The pool sits in front of the swap area (see swap.h): a page
+//	written back to a swap slot is compressed and kept in the pool,
+//	under its slot #, instead of going to the disk.  The pool has a
+//	budget of bytes; once it is over it, the least recently used
+//	pages are taken out and written to their slots on the disk for
+//	real ("spilled").  A page that doesn't compress well enough isn't
+//	worth the room, and goes straight to the disk.
+//
+//	Pages are compressed a word at a time.  A page whose words are
+//	all the same -- in particular one that is all zeroes -- is kept
+//	as that one word.  Any other page is kept as the differences
+//	between consecutive words, with runs of the same difference
+//	counted instead of repeated, each number taking as few bytes as
+//	it needs; so arrays of small numbers, or of numbers counting up
+//	or down, take a few bytes.
+
+#ifndef CPOOL_H
+#define CPOOL_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define PoolEntryBytes	16		// bytes of bookkeeping for each page
+					// in the pool, counted in its budget
+extern int PoolBudgetPages;		// budget, in pages' worth of bytes;
+					// 0 means no pool; set with -zp
+
+// The following class defines one page kept in the compressed pool.
+
+class PoolEntry {
+  public:
+    int slot;			// the swap slot the page belongs in
+    int size;			// # of bytes in "data"
+    char *data;			// the compressed page, or NULL if all its
+    unsigned int fill;		// words are "fill"
+    PoolEntry *older;		// the next less/more recently used
+    PoolEntry *newer;		// entries, in a circular list
+};
+
+// The following class defines the compressed pool.
+
+class CompressedPool {
+  public:
+    CompressedPool(int size, int maxBytes);
+				// A pool for the pages of "size" swap
+				// slots, holding "maxBytes" bytes of them
+    ~CompressedPool();
+
+    bool Store(int slot, char *page);
+				// Keep the page at "page" for "slot", if it
+				// compresses well enough; return FALSE if
+				// it doesn't, and it has to go to the disk
+    bool Load(int slot, char *into);
+				// Copy the page kept for "slot" into "into";
+				// return FALSE if it isn't in the pool
+    void Remove(int slot);	// Forget the page kept for "slot", if any
+    bool Holds(int slot) { return entries[slot] != NULL; }
+
+    bool OverBudget() { return bytes > budget; }
+    int Oldest();		// The least recently used page's slot,
+				// or -1 if the pool is empty
+
+  private:
+    PoolEntry **entries;	// the entry of each slot, or NULL
+    PoolEntry *newest;		// the most recently used entry
+    int numSlots;
+    int budget;			// the most bytes the pool should hold
+    int bytes;			// and how many it holds
+
+    void Touch(PoolEntry *entry);	// Make it the most recently used
+    void Unlink(PoolEntry *entry);	// Take it off the list
+};
+
+#endif // CPOOL_H
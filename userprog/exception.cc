@@ -27,11 +27,14 @@
 #include "machine.h"
 #include "translate.h"
 #include <stdio.h>
+#include <string.h>
 #include "openfile.h"
 #include "filesys.h"
 #include "addrspace.h"
+#include "pageout.h"
 extern Machine *machine;
 extern FileSystem *fileSystem;
+void ExitProcess(int status);
 #define LRU
 
 //----------------------------------------------------------------------
@@ -69,20 +72,10 @@ void IncrementPCRegs(void)
 
 char *getFileNameFromAddress(int address)
 {
-    int position = 0;
-    int data;
-    char name[FILENAME_MAX + 1];
-    do
-    {
-        // each time read one byte
-        bool success = machine->ReadMem(address + position, 1, &data);
-        //ASSERT_MSG(success, "Fail to read memory in Create syscall");
-        ASSERT(success);
-        name[position++] = (char)data;
-        ASSERT(position <= FILENAME_MAX);
-        //ASSERT_MSG(position <= FileNameMaxLength, "Filename length too long")
-    } while (data != '\0');
-    name[position] = '\0';
+    char *name = new char[FILENAME_MAX + 1];
+    int length = machine->CopyInString(address, name, FILENAME_MAX + 1);
+    //ASSERT_MSG(length >= 0, "Filename length too long")
+    ASSERT(length >= 0);
     //printf("==> AddressName: %s", name);
     return name;
 }
@@ -104,6 +97,7 @@ void FileSystemHandler(int type)
         {
             DEBUG('S', "File \"%s\" creation Failed.\n", name);
         }
+        delete [] name;
     }
     else if (type == SC_Open)
     {
@@ -112,6 +106,7 @@ void FileSystemHandler(int type)
         char *name = getFileNameFromAddress(address);
         OpenFile *openFile = fileSystem->Open(name);
         DEBUG('S', "File \"%s\" opened.\n", name);
+        delete [] name;
         machine->WriteRegister(2, (OpenFileId)openFile);
     }
     else if (type == SC_Write)
@@ -121,12 +116,13 @@ void FileSystemHandler(int type)
         OpenFileId id = machine->ReadRegister(6);
         DEBUG('S', "Recieved Syscall Write (r4 = %d, r5 = %d, r6 = %d): ", address, size, id);
         char *buffer = new char[size];
-        for (int i = 0; i < size; i++)
+        OpenFile *openFile = (OpenFile *)id;
+        int numBytes = -1;
+        if (machine->CopyIn(address, buffer, size))
         {
-            machine->ReadMem(address + i, 1, (int *)&buffer[i]);
+            numBytes = openFile->Write(buffer, size);
         }
-        OpenFile *openFile = (OpenFile *)id;
-        int numBytes = openFile->Write(buffer, size);
+        delete [] buffer;
         DEBUG('S', "Write %d bytes into file.\n", numBytes);
         machine->WriteRegister(2, numBytes);
     }
@@ -140,10 +136,11 @@ void FileSystemHandler(int type)
         char *buffer = new char[size];
         OpenFile *openFile = (OpenFile *)id;
         int numBytes = openFile->Read(buffer, size);
-        for (int i = 0; i < numBytes; i++)
+        if (numBytes > 0 && !machine->CopyOut(address, buffer, numBytes))
         {
-            machine->WriteMem(address + i, 1, (int)&buffer[i]);
+            numBytes = -1;
         }
+        delete [] buffer;
         DEBUG('S', "Write %d bytes into file.\n", numBytes);
         machine->WriteRegister(2, numBytes);
     }
@@ -164,6 +161,11 @@ void __exec(int arg)
     AddrSpace *space2 = new AddrSpace(ex2);
     currentThread->space = space2;
     currentThread->filename = filename;
+    if (!space2->Fits())
+    {
+        printf("Program %s is too big to run\n", filename);
+        ExitProcess(-1);
+    }
     space2->InitRegisters();
     space2->RestoreState();
     printf("Thread %s Start Running.\n", currentThread->getName());
@@ -175,27 +177,30 @@ void __exec(int arg)
 }
 void __fork(int address)
 {
+    currentThread->RestoreUserState();  // a copy of the parent's
     currentThread->space->RestoreState();
     machine->WriteRegister(PCReg, address);
     machine->WriteRegister(NextPCReg, address + 4);
     machine->Run();
 }
-void ThreadHandler(int type)
+
+//----------------------------------------------------------------------
+// ExitProcess
+// 	End the running user program with "status": give its address
+//	space back and finish the thread.  Used by Exit, and when the
+//	program touches memory it doesn't have.
+//----------------------------------------------------------------------
+
+void ExitProcess(int status)
 {
-    if (type == SC_Exit)
-    {
-        //Thread::ts();
-        int address = machine->ReadRegister(4);
-        DEBUG('S', "Recieved Syscall [Exit] (r4 = %d): ", address);
-        printf("Program Exit with Status %d\n", address);
-        // for (int i = 0; i < machine->pageTableSize; i++)
-        // {
-        //     if (machine->pageTable[i].valid == TRUE)
-        //     {
-        //         int idx = machine->pageTable[i].physicalPage;
-        //         machine->bitmap->clear(idx);
-        //     }
-        // }
+        printf("Program Exit with Status %d\n", status);
+        AddrSpace *space = currentThread->space;
+        if (machine->tlb != NULL)
+            space->PrintTLBStats();
+        if (PFFInterval > 0)
+            space->PrintFrameStats();
+        currentThread->space = NULL;
+        delete space;               // gives back its frames
         // if (currentThread->getName() == "main")
         // {
         //     IncrementPCRegs();
@@ -217,30 +222,25 @@ void ThreadHandler(int type)
         // }
         IncrementPCRegs();
          currentThread->Finish();
+}
+
+void ThreadHandler(int type)
+{
+    if (type == SC_Exit)
+    {
+        //Thread::ts();
+        int address = machine->ReadRegister(4);
+        DEBUG('S', "Recieved Syscall [Exit] (r4 = %d): ", address);
+        ExitProcess(address);
     }
     else if (type == SC_Exec)
     {
         int address = machine->ReadRegister(4);
         //printf("-->%d\n", address);
         DEBUG('S', "Recieved Syscall [Exec] (r4 = %d): ", address);
-        int value;
-        int count = 0;
-        do
-        {
-            machine->ReadMem(address++, 1, &value);
-            count++;
-        } while (value != 0);
-        address = address - count;
-        char filename[count];
-        for (int i = 0; i < count; i++)
-        {
-            machine->ReadMem(address + i, 1, &value);
-            filename[i] = char(value);
-        }
-        filename[count] = '\0';
+        char *filename = getFileNameFromAddress(address);
         //printf("\n==>filename: %s\n", filename);
 
-        //char* filename = getFileNameFromAddress(address);
         Thread *newThread = Thread::createThread("exec");
 
         bool found = FALSE;
@@ -257,6 +257,7 @@ void ThreadHandler(int type)
         if (!found)
         {
             printf("Current Thread Full\n");
+            delete [] filename;
             IncrementPCRegs();
             return;
         }
@@ -297,9 +298,10 @@ void ThreadHandler(int type)
             }
         }
 
-        if (!found)
+        if (!found)                 // it has exited already
         {
             printf("Cannot find Thread.\n");
+            IncrementPCRegs();
             return;
         }
         while (currentThread->childThreads[joinNum] != NULL)
@@ -319,10 +321,216 @@ void ThreadHandler(int type)
     }
     else if (type == SC_Fork)
     {
-        DEBUG('S', "Recieved Syscall [FORK]");
+        int address = machine->ReadRegister(4);
+        DEBUG('S', "Recieved Syscall [FORK] (r4 = %d)\n", address);
+
+        int slot = -1;
+        for (int i = 0; i < 128; i++)
+        {
+            if (currentThread->childThreads[i] == NULL)
+            {
+                slot = i;
+                break;
+            }
+        }
+        if (slot == -1)             // no room to keep track of a child
+        {
+            printf("Current Thread Full\n");
+            machine->WriteRegister(2, -1);
+            IncrementPCRegs();
+            return;
+        }
+
+        Thread *newThread = Thread::createThread("fork");
+        if (newThread == NULL)      // too many threads in the system
+        {
+            machine->WriteRegister(2, -1);
+            IncrementPCRegs();
+            return;
+        }
+        currentThread->childThreads[slot] = newThread;
+        newThread->fatherThread = currentThread;
+        newThread->space = new AddrSpace(currentThread->space);
+        newThread->SaveUserState();  // starts with our registers
+        machine->WriteRegister(2, (int)newThread);
+        newThread->Fork(__fork, address);
+        IncrementPCRegs();
+    }
+}
+
+//----------------------------------------------------------------------
+// AcquireVM
+// 	Acquire vmLock, to handle a fault of the running process -- but
+//	if the PFF controller has suspended the process, wait until it
+//	is let back in first.
+//----------------------------------------------------------------------
+
+void AcquireVM()
+{
+    AddrSpace *space = currentThread->space;
+
+    vmLock->Acquire();
+    while (space->suspended)
+    {
+        vmLock->Release();
+        pffController->WaitForResume(space);
+        vmLock->Acquire();
     }
 }
 
+//----------------------------------------------------------------------
+// PageIn
+// 	Bring virtual page "vpn" of the running address space into memory,
+//	and enter it in the inverted page table.  If no frame is free, one
+//	is evicted first; normally the pageout daemon has kept some free.
+//
+//	The pages after it that the address space says can be read in
+//	with it are brought in too, as long as there are free frames for
+//	them; nothing is evicted to make room for those.
+//
+//	A code page that another process running the same program has
+//	in memory already is just mapped.  Any other fault is reported to
+//	the PFF controller first, which may take frames away from this
+//	process, or from others.
+//
+//	Returns NULL if no frame can be freed for the page: every frame
+//	holds a modified page, and swap is full.
+//----------------------------------------------------------------------
+
+TranslationEntry *PageIn(unsigned int vpn)
+{
+    AddrSpace *space = currentThread->space;
+    int frames[MaxFaultAround];
+    TranslationEntry *entry, *faulted = NULL;
+    int count, pos, n;
+    bool zero;
+
+    faulted = space->MapSharedText(vpn);
+    if (faulted != NULL)
+        return faulted;
+    pffController->Faulted(space);
+    count = space->FaultAround(vpn);
+    zero = space->ZeroFill(vpn);
+    pos = coreMap->Allocate(space, vpn, zero);
+
+    while (pos == -1)
+    {
+        if (!Evict())
+            return NULL;            // out of swap space
+        pos = coreMap->Allocate(space, vpn, zero);
+    }
+    frames[0] = pos;
+    for (n = 1; n < count; n++)
+    {
+        frames[n] = coreMap->Allocate(space, vpn + n, FALSE);
+        if (frames[n] == -1)
+            break;
+    }
+    count = n;
+    DEBUG('M', "PageFault vpn %d pos %d, plus %d pages\n", vpn, pos, count - 1);
+    for (n = 0; n < count; n++)
+        machine->InvalidateDecodeCache(frames[n]);
+    machine->FlushHostTLB();
+    space->LoadPages(vpn, frames, count);
+    stats->numPrefetched += count - 1;
+    for (n = 0; n < count; n++)
+    {
+        coreMap->Frame(frames[n])->pinned = FALSE;
+        entry = space->MapPage(vpn + n, frames[n]);
+        if (n == 0)
+            faulted = entry;
+    }
+    pageoutDaemon->Wakeup();
+    return faulted;
+}
+
+//----------------------------------------------------------------------
+// CopyOnWrite
+// 	The running address space has stored to virtual page "vpn", which
+//	Fork left it sharing, read-only, with other address spaces.  Give
+//	it a copy of its own to write to, and return the new translation.
+//	If nobody else maps the frame any more, there is nothing to copy,
+//	and the page is just made writable again.  Returns NULL if there
+//	is no frame for the copy, as PageIn.
+//----------------------------------------------------------------------
+
+TranslationEntry *CopyOnWrite(unsigned int vpn)
+{
+    AddrSpace *space = currentThread->space;
+    int spaceId = space->getSpaceId();
+    TranslationEntry *entry = machine->pageTable->Lookup(spaceId, vpn);
+    int from = entry->physicalPage;
+    int to;
+
+    ASSERT(entry->readOnly);
+    if (coreMap->Frame(from)->refCount > 1)
+    {
+        coreMap->Frame(from)->pinned = TRUE;    // don't evict it meanwhile
+        to = coreMap->Allocate(space, vpn, FALSE);
+        while (to == -1)
+        {
+            if (!Evict())
+            {
+                coreMap->Frame(from)->pinned = FALSE;
+                return NULL;        // out of swap space
+            }
+            to = coreMap->Allocate(space, vpn, FALSE);
+        }
+        coreMap->Frame(from)->pinned = FALSE;
+        DEBUG('M', "Copy on write vpn %d, frame %d to %d\n", vpn, from, to);
+        memcpy(&(machine->mainMemory[to * PageSize]),
+               &(machine->mainMemory[from * PageSize]), PageSize);
+        machine->InvalidateDecodeCache(to);
+        coreMap->Unshare(from, space);
+        coreMap->Frame(to)->dirty = TRUE;       // only in memory so far
+        coreMap->Frame(to)->pinned = FALSE;
+        machine->pageTable->Remove(spaceId, vpn);
+        entry = machine->pageTable->Insert(spaceId, vpn, to);
+        stats->numCopiesOnWrite++;
+        pageoutDaemon->Wakeup();
+    }
+    entry->readOnly = FALSE;
+    machine->FlushHostTLB();
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// LoadTLB
+// 	Put the translation "entry" of the running address space into the
+//	TLB, tagged with its ASID, in the slot the machine picks: an empty
+//	one of the page's set, or the set's least recently used one.  The
+//	slot may hold another address space's entry, which goes back to
+//	that one's page table -- except in a direct-mapped TLB, which
+//	keeps the entry it replaces in its extra slot a while longer.
+//----------------------------------------------------------------------
+
+void LoadTLB(TranslationEntry *entry)
+{
+    TranslationEntry *tlb = machine->tlb;
+    int slot = machine->TLBVictim(entry->virtualPage);
+    TranslationEntry *spare = &tlb[TLBSize];
+
+    if (tlb[slot].valid)
+    {
+        if (machine->numTLBEntries > TLBSize)
+        {
+            if (spare->valid)
+                AddrSpace::ASIDOwner(spare->asid)->UnloadTLBEntry(spare);
+            *spare = tlb[slot];
+        }
+        else
+            AddrSpace::ASIDOwner(tlb[slot].asid)->UnloadTLBEntry(&tlb[slot]);
+    }
+    tlb[slot].valid = true;
+    tlb[slot].asid = machine->currentASID;
+    tlb[slot].virtualPage = entry->virtualPage;
+    tlb[slot].physicalPage = entry->physicalPage;
+    tlb[slot].readOnly = entry->readOnly;
+    tlb[slot].use = false;
+    tlb[slot].dirty = false;
+    machine->FlushHostTLB();
+}
+
 void ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
@@ -342,102 +550,109 @@ void ExceptionHandler(ExceptionType which)
         {
             ThreadHandler(type);
         }
+        else if (type == SC_Sbrk)
+        {
+            int increment = machine->ReadRegister(4);
+            DEBUG('S', "Recieved Syscall [Sbrk] (r4 = %d)\n", increment);
+            machine->WriteRegister(2, currentThread->space->Sbrk(increment));
+            IncrementPCRegs();
+        }
+        else if (type == SC_Mmap)
+        {
+            OpenFileId id = machine->ReadRegister(4);
+            int length = machine->ReadRegister(5);
+            DEBUG('S', "Recieved Syscall [Mmap] (r4 = %d, r5 = %d)\n", id, length);
+            OpenFile *openFile = (OpenFile *)id;
+            machine->WriteRegister(2, currentThread->space->Mmap(openFile, length));
+            IncrementPCRegs();
+        }
+        else if (type == SC_Munmap)
+        {
+            int address = machine->ReadRegister(4);
+            DEBUG('S', "Recieved Syscall [Munmap] (r4 = %d)\n", address);
+            machine->WriteRegister(2, currentThread->space->Munmap(address));
+            IncrementPCRegs();
+        }
     }
 
     else if (which == PageFaultException)
     {
-        int method = 0;
-        if (machine->tlb == NULL)
-        {
-            OpenFile *openfile = fileSystem->Open("virtual_memory");
-            if (openfile == NULL)
-                ASSERT(false);
-            int virtAddr = machine->registers[BadVAddrReg];
-            unsigned int vpn = (unsigned)virtAddr / PageSize;
-            unsigned int offset = (unsigned)virtAddr % PageSize;
-            int pos = machine->bitmap->find();
-
-            if (pos == -1)
-            {
-                pos = 0;
-                for (int j = 0; j < machine->pageTableSize; j++)
-                {
-                    if (machine->pageTable[j].physicalPage == 0)
-                    {
-                        if (machine->pageTable[j].dirty == TRUE)
-                        {
-                            openfile->WriteAt(&(machine->mainMemory[pos * PageSize]),
-                                              PageSize, machine->pageTable[j].virtualPage * PageSize);
-                            machine->pageTable[j].valid = FALSE;
-                            break;
-                        }
-                    }
-                }
-            }
-            DEBUG('M', "PageFault vpn %d pos %d\n", vpn, pos);
-            openfile->ReadAt(&(machine->mainMemory[pos * PageSize]), PageSize, vpn * PageSize);
-            machine->pageTable[pos].valid = TRUE;
-            machine->pageTable[pos].virtualPage = vpn;
-            //machine->pageTable[vpn].physicalPage = pos;
-            machine->pageTable[pos].use = FALSE;
-            machine->pageTable[pos].dirty = FALSE;
-            machine->pageTable[pos].readOnly = FALSE;
-            delete openfile;
+        int virtAddr = machine->registers[BadVAddrReg];
+        unsigned int vpn = (unsigned)virtAddr / PageSize;
+        bool woken = pageoutDaemon->Pending();
+        int start = stats->totalTicks;
+        if (!currentThread->space->InUse(vpn))
+        {                           // not heap or stack, nor room to
+                                    // grow the stack into
+            printf("Segmentation fault at address %d\n", virtAddr);
+            ExitProcess(-1);
         }
-        else
+        AcquireVM();
+        TranslationEntry *entry = machine->pageTable->Lookup(machine->currentSpace, vpn);
+
+        if (entry == NULL)          // not in memory at all
         {
-            TranslationEntry *entry, *tlb;
-            int virtAddr = machine->registers[BadVAddrReg];
-            unsigned int vpn = (unsigned)virtAddr / PageSize;
-            unsigned int offset = (unsigned)virtAddr % PageSize;
-            entry = &machine->pageTable[vpn];
-            tlb = machine->tlb;
-            bool flag = false;
-
-            for (int i = 0; i < TLBSize; i++)
-            {
-                if (tlb[i].valid)
-                {
-                    tlb[i].cnt++;
-                }
-            }
+            stats->numPageFaults++;
+            entry = PageIn(vpn);
+        }
+        if (entry == NULL)          // no frame for it, and no room in
+        {                           // swap to free one
+            vmLock->Release();
+            printf("Out of swap space at address %d\n", virtAddr);
+            ExitProcess(-1);
+        }
+        if (machine->tlb != NULL)   // in memory, but not in the TLB
+            LoadTLB(entry);
+        vmLock->Release();
+        if (machine->tlb != NULL)
+            currentThread->space->CountTLBMiss(stats->totalTicks - start);
+        if (!woken && pageoutDaemon->Pending())
+            currentThread->Yield(); // let the daemon we woke refill the
+                                    // reserve
+    }
+    else if (which == ReadOnlyException)
+    {
+        int virtAddr = machine->registers[BadVAddrReg];
+        unsigned int vpn = (unsigned)virtAddr / PageSize;
+        bool woken = pageoutDaemon->Pending();
+        AcquireVM();
+        TranslationEntry *tlbEntry = currentThread->space->FindTLBEntry(vpn);
+        if (tlbEntry != NULL)       // drop the read-only copy
+            currentThread->space->UnloadTLBEntry(tlbEntry);
+        TranslationEntry *entry = machine->pageTable->Lookup(machine->currentSpace, vpn);
 
-            for (int i = 0; i < TLBSize; i++)
-            {
-                if (!tlb[i].valid)
-                {
-                    tlb[i].valid = true;
-                    tlb[i].virtualPage = entry->virtualPage;
-                    tlb[i].physicalPage = entry->physicalPage;
-                    tlb[i].readOnly = entry->readOnly;
-                    tlb[i].use = false;
-                    tlb[i].dirty = false;
-                    tlb[i].cnt = 0;
-
-                    flag = true;
-                    break;
-                }
-            }
-            if (!flag)
-            {
-                int maxcnt = 0;
-                int maxidx = -1;
-                for (int i = 0; i < TLBSize; i++)
-                {
-                    if (tlb[i].cnt > maxcnt)
-                    {
-                        maxcnt = tlb[i].cnt;
-                        maxidx = i;
-                    }
-                }
-                tlb[maxidx].virtualPage = entry->virtualPage;
-                tlb[maxidx].physicalPage = entry->physicalPage;
-                tlb[maxidx].readOnly = entry->readOnly;
-                tlb[maxidx].use = false;
-                tlb[maxidx].dirty = false;
-                tlb[maxidx].cnt = 0;
+        if (entry == NULL)          // evicted while we waited for the lock
+        {
+            stats->numPageFaults++;
+            entry = PageIn(vpn);
+        }
+        else if (entry->readOnly)
+        {
+            if (coreMap->Frame(entry->physicalPage)->text != NULL)
+            {                       // code is never writable
+                vmLock->Release();
+                printf("Write to code page at address %d\n", virtAddr);
+                ExitProcess(-1);
             }
+            entry = CopyOnWrite(vpn);   // shared since a Fork
         }
+        if (entry == NULL)          // no frame for it, and no room in
+        {                           // swap to free one
+            vmLock->Release();
+            printf("Out of swap space at address %d\n", virtAddr);
+            ExitProcess(-1);
+        }
+        if (machine->tlb != NULL)
+            LoadTLB(entry);
+        vmLock->Release();
+        if (!woken && pageoutDaemon->Pending())
+            currentThread->Yield();
+    }
+    else if (which == AddressErrorException)
+    {
+        printf("Address error at address %d\n",
+               machine->registers[BadVAddrReg]);
+        ExitProcess(-1);
     }
     else
     {
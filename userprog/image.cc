@@ -0,0 +1,233 @@
+// image.cc
+//	Routines to manage executable images, and the cache of the images
+//	of the programs that are running.
+
+#include "copyright.h"
+#include "system.h"
+#include "image.h"
+#include <string.h>
+
+static ExecImage *images = NULL;	// the images in use
+
+//----------------------------------------------------------------------
+// SwapHeader
+// 	Do little endian to big endian conversion on the bytes in the
+//	object file header, in case the file was generated on a little
+//	endian machine, and we're now running on a big endian machine.
+//----------------------------------------------------------------------
+
+static void
+SwapHeader (NoffHeader *noffH)
+{
+	noffH->noffMagic = WordToHost(noffH->noffMagic);
+	noffH->code.size = WordToHost(noffH->code.size);
+	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
+	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
+	noffH->initData.size = WordToHost(noffH->initData.size);
+	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
+	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
+	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
+	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
+	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
+}
+
+//----------------------------------------------------------------------
+// CopySegment
+// 	Copy the part of segment "seg" that falls in the "numPages"
+//	virtual pages starting at "vpn" from the object file "executable"
+//	into "pages", in one read.  The rest of "pages" is left alone.
+//
+//	Returns FALSE if none of the segment is in those pages.
+//----------------------------------------------------------------------
+
+static bool
+CopySegment(OpenFile *executable, Segment *seg, int vpn, int numPages,
+		char *pages)
+{
+    int pagesStart = vpn * PageSize;
+    int start = max(seg->virtualAddr, pagesStart);
+    int end = min(seg->virtualAddr + seg->size,
+			pagesStart + numPages * PageSize);
+
+    if (start >= end)
+	return FALSE;
+    executable->ReadAt(pages + (start - pagesStart), end - start,
+			seg->inFileAddr + (start - seg->virtualAddr));
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ExecImage::ExecImage
+// 	Read the header of a NOFF object file, checking that it is one,
+//	and find out which pages hold only code.
+//
+//	Segments come one after another in the address space, code first,
+//	so the code pages end where the first page holding some data
+//	starts; a page with the end of the code and the start of the data
+//	in it is not a code page.
+//
+//	"executable" is the open object file; the image closes it when
+//	it is deleted.
+//----------------------------------------------------------------------
+
+ExecImage::ExecImage(OpenFile *executable)
+{
+    file = executable;
+    headerSector = file->HeaderSector();
+    file->ReadAt((char *)&noffH, sizeof(noffH), 0);
+    if ((noffH.noffMagic != NOFFMAGIC) &&
+		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    	SwapHeader(&noffH);
+    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    numUsers = 1;
+    next = NULL;
+
+    firstTextPage = endTextPage = 0;
+    if (noffH.code.size > 0) {
+	firstTextPage = divRoundUp(noffH.code.virtualAddr, PageSize);
+	endTextPage = (noffH.code.virtualAddr + noffH.code.size) / PageSize;
+	if (noffH.initData.size > 0)
+	    endTextPage = min(endTextPage,
+				noffH.initData.virtualAddr / PageSize);
+	if (noffH.uninitData.size > 0)
+	    endTextPage = min(endTextPage,
+				noffH.uninitData.virtualAddr / PageSize);
+	endTextPage = max(endTextPage, firstTextPage);
+    }
+    textFrames = new int[endTextPage - firstTextPage + 1];
+    for (int i = 0; i < endTextPage - firstTextPage; i++)
+	textFrames[i] = -1;
+}
+
+//----------------------------------------------------------------------
+// ExecImage::~ExecImage
+// 	Close the object file.  None of the code can still be in memory,
+//	since nobody is using it.
+//----------------------------------------------------------------------
+
+ExecImage::~ExecImage()
+{
+    ASSERT(numUsers == 0);
+    for (int i = 0; i < endTextPage - firstTextPage; i++)
+	ASSERT(textFrames[i] == -1);
+    delete [] textFrames;
+    delete file;
+}
+
+//----------------------------------------------------------------------
+// ExecImage::Detach
+// 	An address space is done with the image.
+//
+//	Returns TRUE if no address space uses it any more, so that the
+//	caller can delete it.
+//----------------------------------------------------------------------
+
+bool
+ExecImage::Detach()
+{
+    ASSERT(numUsers > 0);
+    return --numUsers == 0;
+}
+
+//----------------------------------------------------------------------
+// ExecImage::ReadPages
+// 	Fill the "numPages" * PageSize bytes at "into" with the contents
+//	that the virtual pages starting at "vpn" have when the program
+//	starts: its code and initialized data where they fall, read with
+//	one read per segment, and zeroes everywhere else.
+//----------------------------------------------------------------------
+
+void
+ExecImage::ReadPages(int vpn, int numPages, char *into)
+{
+    memset(into, 0, numPages * PageSize);
+    CopySegment(file, &noffH.code, vpn, numPages, into);
+    CopySegment(file, &noffH.initData, vpn, numPages, into);
+}
+
+//----------------------------------------------------------------------
+// ExecImage::TextFrame
+// 	Return the frame holding code page "vpn", or -1 if it isn't in
+//	memory (or isn't a code page).
+//----------------------------------------------------------------------
+
+int
+ExecImage::TextFrame(int vpn)
+{
+    if (!IsText(vpn))
+	return -1;
+    return textFrames[vpn - firstTextPage];
+}
+
+//----------------------------------------------------------------------
+// ExecImage::CacheText
+// 	Remember that code page "vpn" has been read into "frame", so that
+//	other address spaces running the program can map it.
+//----------------------------------------------------------------------
+
+void
+ExecImage::CacheText(int vpn, int frame)
+{
+    ASSERT(IsText(vpn) && textFrames[vpn - firstTextPage] == -1);
+    textFrames[vpn - firstTextPage] = frame;
+}
+
+//----------------------------------------------------------------------
+// ExecImage::UncacheText
+// 	Forget the frame code page "vpn" was in; it has been freed.
+//----------------------------------------------------------------------
+
+void
+ExecImage::UncacheText(int vpn)
+{
+    ASSERT(IsText(vpn));
+    textFrames[vpn - firstTextPage] = -1;
+}
+
+//----------------------------------------------------------------------
+// OpenImage
+// 	Return the image of the object file "executable", adding one to
+//	its users if another address space is running the same program
+//	already (and closing "executable", which isn't needed then), or
+//	making a new one otherwise.
+//----------------------------------------------------------------------
+
+ExecImage *
+OpenImage(OpenFile *executable)
+{
+    int sector = executable->HeaderSector();
+    ExecImage *image;
+
+    for (image = images; image != NULL; image = image->next)
+	if (image->headerSector == sector) {
+	    DEBUG('a', "Sharing the image of file %d\n", sector);
+	    image->Attach();
+	    delete executable;
+	    return image;
+	}
+    image = new ExecImage(executable);
+    image->next = images;
+    images = image;
+    return image;
+}
+
+//----------------------------------------------------------------------
+// CloseImage
+// 	An address space is done with "image"; take it out of the cache
+//	and delete it if it was the last one using it.
+//----------------------------------------------------------------------
+
+void
+CloseImage(ExecImage *image)
+{
+    ExecImage **link = &images;
+
+    if (!image->Detach())
+	return;
+    while (*link != image) {
+	ASSERT(*link != NULL);
+	link = &(*link)->next;
+    }
+    *link = image->next;
+    delete image;
+}
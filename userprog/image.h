@@ -0,0 +1,69 @@
+// image.h
+//	Data structures for the executable images that address spaces
+//	page their code and initialized data in from.
+//
+//	An image is an open NOFF object file together with its header.
+//	Every address space running the same program uses the same image:
+//	images are kept in a cache, found by the sector holding the file's
+//	header, for as long as some address space uses them.  The image
+//	counts its users, and closes the file when the last one goes away.
+//
+//	Pages that hold nothing but code never change, so they are shared
+//	too: the image remembers the frame each of its code pages is in,
+//	if any, and every address space running the program maps that
+//	frame read-only, instead of reading the page in again.
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "copyright.h"
+#include "openfile.h"
+#include "noff.h"
+
+// The following class defines an executable image.
+
+class ExecImage {
+  public:
+    ExecImage(OpenFile *executable);	// Read the header of "executable",
+					// which the image takes over; it
+					// starts out with one user
+    ~ExecImage();			// Close the file
+
+    void Attach() { numUsers++; }	// One more address space uses it
+    bool Detach();			// One fewer does; returns TRUE if
+					// that was the last one
+
+    void ReadPages(int vpn, int numPages, char *into);
+					// Fill "numPages" virtual pages, from
+					// "vpn" on, with their code and
+					// initialized data, and zeroes
+
+    bool IsText(int vpn)		// Does page "vpn" hold only code?
+	{ return vpn >= firstTextPage && vpn < endTextPage; }
+    int TextFrame(int vpn);		// The frame holding code page "vpn",
+					// or -1 if it isn't in memory
+    void CacheText(int vpn, int frame);	// Code page "vpn" is now in "frame"
+    void UncacheText(int vpn);		// and now it isn't any more
+
+    OpenFile *file;			// the object file
+    NoffHeader noffH;			// where the segments are in it
+    int headerSector;			// the file's header sector, which
+					// tells images apart in the cache
+    ExecImage *next;			// next image in the cache
+
+  private:
+    int numUsers;			// # of address spaces using it
+    int firstTextPage;			// the pages that hold only code
+    int endTextPage;			// are the ones from firstTextPage
+					// up to, not including, endTextPage
+    int *textFrames;			// frame holding each of them, or -1
+};
+
+// Find the image of "executable" in the cache, or put it there.  The
+// caller's reference to "executable" is taken over either way.
+extern ExecImage *OpenImage(OpenFile *executable);
+
+// An address space is done with "image"; delete it if it was the last.
+extern void CloseImage(ExecImage *image);
+
+#endif // IMAGE_H
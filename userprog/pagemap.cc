@@ -0,0 +1,103 @@
+// pagemap.cc
+//	Routines to manage a two-level map from virtual page #'s to the
+//	information kept about each page.
+
+#include "copyright.h"
+#include "pagemap.h"
+
+//----------------------------------------------------------------------
+// PageMap::PageMap
+// 	Create a map for "numPages" virtual pages, with every entry -1.
+//	Only the directory is allocated.
+//----------------------------------------------------------------------
+
+PageMap::PageMap(int numPages)
+{
+    numBlocks = divRoundUp(numPages, PageMapBlock);
+    blocks = new int *[numBlocks];
+    numSet = new int[numBlocks];
+    for (int i = 0; i < numBlocks; i++) {
+	blocks[i] = NULL;
+	numSet[i] = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageMap::PageMap
+// 	Create a copy of the map "other", for Fork.  Only the blocks that
+//	"other" has allocated are copied.
+//----------------------------------------------------------------------
+
+PageMap::PageMap(PageMap *other)
+{
+    numBlocks = other->numBlocks;
+    blocks = new int *[numBlocks];
+    numSet = new int[numBlocks];
+    for (int i = 0; i < numBlocks; i++) {
+	numSet[i] = other->numSet[i];
+	blocks[i] = NULL;
+	if (other->blocks[i] != NULL) {
+	    blocks[i] = new int[PageMapBlock];
+	    for (int j = 0; j < PageMapBlock; j++)
+		blocks[i][j] = other->blocks[i][j];
+	}
+    }
+}
+
+PageMap::~PageMap()
+{
+    for (int i = 0; i < numBlocks; i++)
+	if (blocks[i] != NULL)
+	    delete [] blocks[i];
+    delete [] blocks;
+    delete [] numSet;
+}
+
+//----------------------------------------------------------------------
+// PageMap::Get
+// 	Return the value for virtual page "vpn"; -1 if its block hasn't
+//	been allocated.
+//----------------------------------------------------------------------
+
+int
+PageMap::Get(int vpn)
+{
+    int *block;
+
+    ASSERT(vpn >= 0 && vpn / PageMapBlock < numBlocks);
+    block = blocks[vpn / PageMapBlock];
+    if (block == NULL)
+	return -1;
+    return block[vpn % PageMapBlock];
+}
+
+//----------------------------------------------------------------------
+// PageMap::Set
+// 	Set the value for virtual page "vpn" to "value", allocating its
+//	block if this is the first entry in it that isn't -1, and freeing
+//	it if this was the last.
+//----------------------------------------------------------------------
+
+void
+PageMap::Set(int vpn, int value)
+{
+    int b = vpn / PageMapBlock;
+    int old;
+
+    ASSERT(vpn >= 0 && b < numBlocks);
+    if (blocks[b] == NULL) {
+	if (value == -1)
+	    return;
+	blocks[b] = new int[PageMapBlock];
+	for (int j = 0; j < PageMapBlock; j++)
+	    blocks[b][j] = -1;
+    }
+    old = blocks[b][vpn % PageMapBlock];
+    blocks[b][vpn % PageMapBlock] = value;
+    if (old == -1 && value != -1)
+	numSet[b]++;
+    else if (old != -1 && value == -1 && --numSet[b] == 0) {
+	delete [] blocks[b];
+	blocks[b] = NULL;
+    }
+}
@@ -0,0 +1,42 @@
+// pagemap.h
+//	Data structures for the per-page information an address space
+//	keeps for each of its virtual pages (for now, the swap slot
+//	holding the page).
+//
+//	An address space can be much bigger than the part of it a program
+//	uses -- the heap and the stack grow towards each other from the
+//	two ends -- so a flat array with an entry for every virtual page
+//	would mostly hold nothing.  Instead, a page map is a two-level
+//	table: a directory with one entry for each block of PageMapBlock
+//	consecutive pages, pointing to the block's entries, which are only
+//	allocated once one of them is set, and freed again once none is.
+
+#ifndef PAGEMAP_H
+#define PAGEMAP_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define PageMapBlock	32		// pages in each second-level block
+
+// The following class defines a map from virtual page #'s to ints,
+// which are all -1 to start with.
+
+class PageMap {
+  public:
+    PageMap(int numPages);		// An empty map, for "numPages" pages
+    PageMap(PageMap *other);		// A copy of "other"
+    ~PageMap();
+
+    int Get(int vpn);			// The value for page "vpn"
+    void Set(int vpn, int value);	// Set it to "value"
+
+  private:
+    int numBlocks;			// # of entries in the directory
+    int **blocks;			// each block's entries, or NULL if
+					// they are all -1
+    int *numSet;			// # of entries that aren't -1, in
+					// each block
+};
+
+#endif // PAGEMAP_H
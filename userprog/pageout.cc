@@ -0,0 +1,195 @@
+// pageout.cc
+//	Routines to take frames away from their pages: Evict, used both
+//	by a page fault that finds no free frame and by the pageout
+//	daemon, EvictFrame, also used by the page-fault-frequency
+//	controller, and the daemon itself.
+
+#include "copyright.h"
+#include "system.h"
+#include "pageout.h"
+#include "addrspace.h"
+
+//----------------------------------------------------------------------
+// Unmap
+// 	Take address space "owner"'s mapping of page "vpn", which is in
+//	the frame described by "info", out of the TLB and the inverted
+//	page table, noting in "info" if the page was modified.
+//----------------------------------------------------------------------
+
+static void
+Unmap(AddrSpace *owner, int vpn, FrameInfo *info)
+{
+    int space = owner->getSpaceId();
+    TranslationEntry *entry = machine->pageTable->Lookup(space, vpn);
+    TranslationEntry *tlbEntry = owner->FindTLBEntry(vpn);
+    ASSERT(entry != NULL);
+
+    if (tlbEntry != NULL)
+	owner->UnloadTLBEntry(tlbEntry);
+    if (entry->dirty)
+	info->dirty = TRUE;
+    machine->pageTable->Remove(space, vpn);
+}
+
+//----------------------------------------------------------------------
+// Evict
+// 	Make room in memory: take the frame the replacement policy picks
+//	away from the page in it (see EvictFrame).
+//
+//	vmLock must be held.  Returns FALSE if every frame is pinned, or
+//	if the page is modified and swap is full.  Clean pages could still
+//	be evicted then, but a process may need more of its pages at once
+//	than there are clean frames, and would just take them from itself
+//	forever; better the caller give up.
+//----------------------------------------------------------------------
+
+bool
+Evict()
+{
+    int frame = coreMap->FindVictim();
+
+    if (frame == -1)
+	return FALSE;
+    return EvictFrame(frame);
+}
+
+//----------------------------------------------------------------------
+// EvictFrame
+// 	Take "frame", which must be in use and not pinned, away from the
+//	page in it, writing the page back to swap first if it was
+//	modified, and put the frame on the free list.
+//
+//	A frame shared after a Fork is taken away from every address
+//	space mapping it, and written back once, to a slot they share.
+//
+//	vmLock must be held.  Returns FALSE, leaving the frame as it was,
+//	if the page is modified and there is no swap slot left for it.
+//----------------------------------------------------------------------
+
+bool
+EvictFrame(int frame)
+{
+    FrameInfo *info = coreMap->Frame(frame);
+    int vpn = info->virtualPage;
+    FrameSharer *s;
+
+    ASSERT(coreMap->Replaceable(frame));
+    if (coreMap->IsDirty(frame)
+	    && !info->owner->ReserveSlot(vpn, info->refCount)) {
+	DEBUG('M', "No swap slot for frame %d (vpn %d)\n", frame, vpn);
+	return FALSE;
+    }
+    Unmap(info->owner, vpn, info);
+    for (s = info->sharers; s != NULL; s = s->next)
+	Unmap(s->space, vpn, info);
+    machine->FlushHostTLB();
+
+    DEBUG('M', "Evict frame %d (vpn %d, %s, %d users)\n", frame, vpn,
+	  info->dirty ? "dirty" : "clean", info->refCount);
+    if (info->dirty) {
+	info->pinned = TRUE;		// nobody else may take it meanwhile
+	stats->numPageOuts++;
+	int slot = info->owner->SavePage(vpn, frame, info->refCount);
+	for (s = info->sharers; s != NULL; s = s->next)
+	    s->space->ShareSlot(vpn, slot);
+    }
+    coreMap->Free(frame);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PageoutDaemonThread
+// 	The pageout daemon's thread runs this; Fork can only pass an int.
+//----------------------------------------------------------------------
+
+static void
+PageoutDaemonThread(int daemon)
+{
+    ((PageoutDaemon *) daemon)->Run();
+}
+
+//----------------------------------------------------------------------
+// PageoutDaemon::PageoutDaemon
+// 	Set the watermarks: wake up when fewer than 1/16 of the frames
+//	are free, and free up to 1/8 of them, but always at least one.
+//----------------------------------------------------------------------
+
+PageoutDaemon::PageoutDaemon(int numFrames)
+{
+    lowWater = max(numFrames / 16, 1);
+    highWater = max(numFrames / 8, lowWater + 1);
+    lowOnFrames = new Condition("low on frames");
+    sleeping = woken = FALSE;
+}
+
+PageoutDaemon::~PageoutDaemon()
+{
+    delete lowOnFrames;
+}
+
+//----------------------------------------------------------------------
+// PageoutDaemon::Start
+// 	Fork the thread that runs the daemon.
+//----------------------------------------------------------------------
+
+void
+PageoutDaemon::Start()
+{
+    Thread *t = Thread::createThread("pageout");
+
+    ASSERT(t != NULL);
+    t->Fork(PageoutDaemonThread, (int) this);
+}
+
+//----------------------------------------------------------------------
+// PageoutDaemon::Needed
+// 	Return TRUE if the reserve of free frames has run low.
+//----------------------------------------------------------------------
+
+bool
+PageoutDaemon::Needed()
+{
+    return coreMap->NumFree() < lowWater;
+}
+
+//----------------------------------------------------------------------
+// PageoutDaemon::Wakeup
+// 	Called, with vmLock held, after frames have been taken off the
+//	free list; wakes the daemon if the reserve has run low and it is
+//	asleep.  The daemon runs the next time the caller gives up the
+//	CPU; see Pending.
+//----------------------------------------------------------------------
+
+void
+PageoutDaemon::Wakeup()
+{
+    if (Needed() && sleeping) {
+	lowOnFrames->Signal(vmLock);
+	sleeping = FALSE;
+	woken = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageoutDaemon::Run
+// 	Sleep until free frames run low, then evict pages until there
+//	are enough again.  Modified pages are written back here, ahead of
+//	time, instead of by the page fault that needs their frame.
+//
+//	Once it has started, the daemon holds vmLock except while it
+//	sleeps, so it can't miss a Wakeup.
+//----------------------------------------------------------------------
+
+void
+PageoutDaemon::Run()
+{
+    vmLock->Acquire();
+    for (;;) {
+	sleeping = TRUE;
+	lowOnFrames->Wait(vmLock);
+	woken = FALSE;
+	DEBUG('M', "Pageout daemon: %d frames free\n", coreMap->NumFree());
+	while (coreMap->NumFree() < highWater && Evict())
+	    stats->numDaemonEvictions++;
+    }
+}
@@ -0,0 +1,60 @@
+// pageout.h
+//	Data structures for the pageout daemon: a kernel thread that keeps
+//	a reserve of free frames, so that a page fault can usually take a
+//	free frame instead of first writing back a modified page.
+//
+//	The daemon sleeps until the number of free frames drops below a
+//	low watermark, then evicts the pages the replacement policy picks,
+//	writing back the modified ones, until the number is back up to a
+//	high watermark.
+//
+//	All paging -- page faults, eviction, and deleting an address
+//	space -- is done holding "vmLock", so the daemon and the faulting
+//	threads never work on the core map at the same time, even while
+//	one of them waits for the disk.
+
+#ifndef PAGEOUT_H
+#define PAGEOUT_H
+
+#include "copyright.h"
+#include "synch.h"
+
+// Take one frame away from its page, writing the page back first if
+// it was modified.  Returns FALSE if every frame is pinned, or if the
+// page is modified and swap is full.
+extern bool Evict();
+
+// Take away a given frame, which must be in use and not pinned;
+// FALSE if its page is modified and swap is full.
+extern bool EvictFrame(int frame);
+
+// The following class defines the pageout daemon.
+
+class PageoutDaemon {
+  public:
+    PageoutDaemon(int numFrames);	// Set the watermarks for memory
+					// of "numFrames" frames
+    ~PageoutDaemon();
+
+    void Start();			// Fork the daemon's thread
+
+    bool Needed();			// Are free frames below the low
+					// watermark?
+    void Wakeup();			// If they are, wake the daemon;
+					// vmLock must be held
+    bool Pending() { return woken; }	// Has it been woken, and not run
+					// yet?
+    int Reserve() { return highWater; }	// Free frames it keeps, when memory
+					// is all in use
+
+    void Run();			// The daemon itself; never returns
+
+  private:
+    int lowWater;			// wake up below this many free frames
+    int highWater;			// and free frames up to this many
+    Condition *lowOnFrames;		// where the daemon sleeps
+    bool sleeping;			// is it waiting on lowOnFrames?
+    bool woken;				// signalled, but not running yet?
+};
+
+#endif // PAGEOUT_H
@@ -0,0 +1,197 @@
+// pff.cc
+//	Routines to control how many frames each process has, by how
+//	often it faults, and to suspend and resume processes.
+
+#include "copyright.h"
+#include "system.h"
+#include "pff.h"
+#include "addrspace.h"
+
+int PFFInterval = 0;
+
+//----------------------------------------------------------------------
+// PFFController::PFFController
+// 	Initialize the controller, with no processes yet.  "ticks" is
+//	the # of ticks between page faults below which a process is given
+//	more frames; 0 turns the controller off.
+//----------------------------------------------------------------------
+
+PFFController::PFFController(int ticks)
+{
+    interval = ticks;
+    spaces = NULL;
+}
+
+PFFController::~PFFController()
+{
+}
+
+//----------------------------------------------------------------------
+// PFFController::Add
+// 	Start keeping track of address space "space", a new process.
+//----------------------------------------------------------------------
+
+void
+PFFController::Add(AddrSpace *space)
+{
+    space->nextSpace = spaces;
+    spaces = space;
+}
+
+//----------------------------------------------------------------------
+// PFFController::Remove
+// 	Stop keeping track of address space "space", whose process has
+//	exited.  Its frames are free now, so any suspended process may
+//	be let back in; see WaitForResume.
+//----------------------------------------------------------------------
+
+void
+PFFController::Remove(AddrSpace *space)
+{
+    AddrSpace **link = &spaces;
+
+    while (*link != space) {
+	ASSERT(*link != NULL);
+	link = &(*link)->nextSpace;
+    }
+    *link = space->nextSpace;
+}
+
+//----------------------------------------------------------------------
+// PFFController::Faulted
+// 	Address space "space", which is running, is about to take a frame
+//	for a page fault.  Look at how long it ran since its last one:
+//
+//	If it was longer than "interval", take away the frames it hasn't
+//	referenced since; they aren't part of its working set.
+//
+//	If it was shorter, it is growing.  If memory is short -- the
+//	pageout daemon's reserve is running down -- and other processes
+//	are running, suspend the one with the most frames, to make room.
+//----------------------------------------------------------------------
+
+void
+PFFController::Faulted(AddrSpace *space)
+{
+    int now = space->VirtualTime();
+    int sinceLast = now - space->lastFault;
+    AddrSpace *victim = NULL;
+
+    space->lastFault = now;
+    if (interval == 0)
+	return;
+    if (sinceLast > interval) {
+	Release(space);
+	return;
+    }
+    if (coreMap->NumFree() >= pageoutDaemon->Reserve())
+	return;				// nobody is short of frames yet
+    for (AddrSpace *s = spaces; s != NULL; s = s->nextSpace)
+	if (s != space && !s->suspended
+		&& (victim == NULL || s->numResident > victim->numResident))
+	    victim = s;
+    if (victim != NULL && victim->numResident > 0)
+	Suspend(victim);
+}
+
+//----------------------------------------------------------------------
+// PFFController::Release
+// 	Take away the frames of address space "space" that it hasn't
+//	referenced since we last looked, writing back the modified pages.
+//	Frames shared with other address spaces stay, and so do modified
+//	pages once swap is full.
+//----------------------------------------------------------------------
+
+void
+PFFController::Release(AddrSpace *space)
+{
+    for (int frame = 0; frame < NumPhysPages; frame++) {
+	FrameInfo *info = coreMap->Frame(frame);
+
+	if (info->owner != space || info->refCount > 1 || info->pinned)
+	    continue;
+	if (!coreMap->Referenced(frame) && EvictFrame(frame))
+	    stats->numPFFReleases++;
+    }
+    machine->FlushHostTLB();		// use bits were cleared; see
+					// CoreMap::FindVictim
+    DEBUG('M', "PFF: space %d keeps %d frames\n", space->getSpaceId(),
+	  space->numResident);
+}
+
+//----------------------------------------------------------------------
+// PFFController::Suspend
+// 	Take address space "space" out of memory: take away all of its
+//	frames that aren't shared, writing back the modified pages (as
+//	long as there is room in swap for them), and mark it suspended,
+//	so that its thread waits the next time it faults, until there is
+//	room for as many frames as it had.
+//----------------------------------------------------------------------
+
+void
+PFFController::Suspend(AddrSpace *space)
+{
+    DEBUG('M', "PFF: suspending space %d, with %d frames\n",
+	  space->getSpaceId(), space->numResident);
+    space->suspended = TRUE;
+    space->suspendedAt = stats->totalTicks;
+    space->suspendedFrames = space->numResident;
+    space->numSuspensions++;
+    stats->numSuspensions++;
+    for (int frame = 0; frame < NumPhysPages; frame++) {
+	FrameInfo *info = coreMap->Frame(frame);
+
+	if (info->owner == space && info->refCount == 1 && !info->pinned)
+	    EvictFrame(frame);
+    }
+}
+
+//----------------------------------------------------------------------
+// PFFController::CanResume
+// 	Return TRUE if suspended address space "space" may run again:
+//	if it has waited SuspendTicks; or else, if it was suspended before
+//	any other still suspended, and either nobody else is running or
+//	there are enough free frames for the ones it had, on top of the
+//	pageout daemon's reserve.
+//----------------------------------------------------------------------
+
+bool
+PFFController::CanResume(AddrSpace *space)
+{
+    bool othersRunning = FALSE;
+
+    if (stats->totalTicks - space->suspendedAt >= SuspendTicks)
+	return TRUE;
+    for (AddrSpace *s = spaces; s != NULL; s = s->nextSpace) {
+	if (s->suspended && s->suspendedAt < space->suspendedAt)
+	    return FALSE;
+	if (!s->suspended)
+	    othersRunning = TRUE;
+    }
+    return !othersRunning || coreMap->NumFree()
+		>= space->suspendedFrames + pageoutDaemon->Reserve();
+}
+
+//----------------------------------------------------------------------
+// PFFController::WaitForResume
+// 	Called by the thread of address space "space" when it faults
+//	while suspended: give up the CPU until the space may run again,
+//	then let it fault its pages back in.
+//
+//	vmLock must not be held, since the processes still running need
+//	it to fault, and to exit.
+//----------------------------------------------------------------------
+
+void
+PFFController::WaitForResume(AddrSpace *space)
+{
+    while (space->suspended) {
+	if (CanResume(space)) {
+	    DEBUG('M', "PFF: resuming space %d\n", space->getSpaceId());
+	    space->suspended = FALSE;
+	    space->lastFault = space->VirtualTime();
+	    break;
+	}
+	currentThread->Yield();
+    }
+}
@@ -0,0 +1,71 @@
+// pff.h
+//	Data structures for the page-fault-frequency controller, which
+//	decides how many frames each process gets, and takes processes
+//	out of memory altogether when they can't all have what they need.
+//
+//	Global replacement alone lets one process take frames from all
+//	the others; once the processes together need more frames than
+//	there are, every one of them is always faulting ("thrashing").
+//	The controller keeps each process's resident set near its working
+//	set instead, judging it by how often the process faults, in its
+//	own virtual time (the user ticks it has run for):
+//
+//	   - faulting less often than once every PFFInterval ticks, it
+//	     has more frames than it needs: at each such fault, the frames
+//	     it hasn't referenced since its last fault are taken away;
+//
+//	   - faulting more often, it needs more: it just keeps the frames
+//	     it faults in.  If memory has run short, another process -- the
+//	     one with the most frames -- is suspended, and its frames freed
+//	     for the others.
+//
+//	A suspended process doesn't run; it waits until there are as many
+//	free frames as it had, or nobody else is running, or it has been
+//	suspended for SuspendTicks, whichever comes first, and then gets
+//	its pages back by faulting them in.  Suspended processes are let
+//	back in the order they were suspended.
+//
+//	Frames shared with other processes (after a Fork, or code pages)
+//	are left alone; they are no use to take away from one of them.
+
+#ifndef PFF_H
+#define PFF_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class AddrSpace;
+
+#define SuspendTicks	100000		// longest a process stays suspended
+extern int PFFInterval;			// ticks between faults below which a
+					// process needs more frames; 0 means
+					// no control; set with -pff
+
+// The following class defines the page-fault-frequency controller.
+
+class PFFController {
+  public:
+    PFFController(int ticks);		// Control processes faulting once
+					// every "ticks" ticks or more
+    ~PFFController();
+
+    void Add(AddrSpace *space);		// A new process; vmLock must be held
+    void Remove(AddrSpace *space);	// One that has exited
+    void Faulted(AddrSpace *space);	// "space" is about to take a frame
+					// for a page fault; vmLock must be
+					// held
+    void WaitForResume(AddrSpace *space);
+					// Wait while "space" is suspended;
+					// vmLock must not be held
+
+  private:
+    int interval;			// ticks between faults, or 0
+    AddrSpace *spaces;			// every address space, linked by
+					// their "nextSpace"
+
+    void Release(AddrSpace *space);	// Take away its unreferenced frames
+    void Suspend(AddrSpace *space);	// Take away all its frames
+    bool CanResume(AddrSpace *space);	// Is it time to let it back in?
+};
+
+#endif // PFF_H
@@ -25,9 +25,12 @@ void MultiThreadTest(int which){
         return;
     }
     space = new AddrSpace(executable);    
-    currentThread->space = space;
-
-    delete executable;			// close file
+    if (!space->Fits()) {
+        printf("Program %s is too big to run\n", filename);
+        delete space;
+        return;
+    }
+    currentThread->space = space;	// it closes the executable
 
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
@@ -57,9 +60,12 @@ StartProcess(char *filename)
         return;
     }
     space = new AddrSpace(executable);    
-    currentThread->space = space;
-
-    delete executable;			// close file
+    if (!space->Fits()) {
+        printf("Program %s is too big to run\n", filename);
+        delete space;			// it closes the executable
+        return;
+    }
+    currentThread->space = space;	// it closes the executable
 
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
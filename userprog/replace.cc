@@ -0,0 +1,296 @@
+// replace.cc
+//	Routines implementing the page replacement policies.
+//
+//	A policy only sees frame #'s; it asks the core map whether a
+//	frame can be replaced, and for its use and dirty bits.
+
+#include "copyright.h"
+#include "system.h"
+#include "replace.h"
+#include "coremap.h"
+#include <string.h>
+
+//----------------------------------------------------------------------
+// NewReplacementPolicy
+// 	Make the replacement policy called "name" (see replace.h), for
+//	"frameMap", which has "frames" frames.
+//
+//	Returns NULL if there is no policy called "name".
+//----------------------------------------------------------------------
+
+ReplacementPolicy *
+NewReplacementPolicy(const char *name, CoreMap *frameMap, int frames)
+{
+    if (!strcmp(name, "fifo"))
+	return new FIFOPolicy(frameMap, frames, FALSE);
+    if (!strcmp(name, "second"))
+	return new FIFOPolicy(frameMap, frames, TRUE);
+    if (!strcmp(name, "clock"))
+	return new ClockPolicy(frameMap, frames);
+    if (!strcmp(name, "aging"))
+	return new AgingPolicy(frameMap, frames);
+    if (!strcmp(name, "wsclock"))
+	return new WSClockPolicy(frameMap, frames);
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// FIFOPolicy::FIFOPolicy
+// 	Initialize a FIFO policy, with no frames in use.
+//
+//	"useSecondChance" -- if TRUE, a frame that has been used since it
+//		was last looked at is moved to the end of the list
+//		instead of being replaced
+//----------------------------------------------------------------------
+
+FIFOPolicy::FIFOPolicy(CoreMap *frameMap, int frames, bool useSecondChance)
+{
+    map = frameMap;
+    numFrames = frames;
+    secondChance = useSecondChance;
+    next = new int[numFrames];
+    prev = new int[numFrames];
+    oldest = -1;
+}
+
+FIFOPolicy::~FIFOPolicy()
+{
+    delete [] next;
+    delete [] prev;
+}
+
+//----------------------------------------------------------------------
+// FIFOPolicy::Allocated
+// 	Put a newly allocated frame at the end of the list.
+//----------------------------------------------------------------------
+
+void
+FIFOPolicy::Allocated(int frame)
+{
+    if (oldest == -1) {
+	next[frame] = prev[frame] = frame;
+	oldest = frame;
+    } else {				// insert just before the oldest,
+	next[frame] = oldest;		// i.e., at the end of the list
+	prev[frame] = prev[oldest];
+	next[prev[oldest]] = frame;
+	prev[oldest] = frame;
+    }
+}
+
+//----------------------------------------------------------------------
+// FIFOPolicy::Freed
+// 	Take a frame off the list.
+//----------------------------------------------------------------------
+
+void
+FIFOPolicy::Freed(int frame)
+{
+    if (next[frame] == frame)		// the only frame in use
+	oldest = -1;
+    else {
+	next[prev[frame]] = next[frame];
+	prev[next[frame]] = prev[frame];
+	if (oldest == frame)
+	    oldest = next[frame];
+    }
+}
+
+//----------------------------------------------------------------------
+// FIFOPolicy::FindVictim
+// 	Return the frame that has been in use the longest, skipping
+//	pinned frames.  With second chance, a frame whose use bit is set
+//	has the bit cleared and goes to the end of the list instead.
+//----------------------------------------------------------------------
+
+int
+FIFOPolicy::FindVictim()
+{
+    int frame = oldest;
+    int following;
+
+    if (frame == -1)
+	return -1;
+    for (int i = 0; i < 2 * numFrames; i++) {	// twice, in case every
+	following = next[frame];		// frame had its use bit set
+	if (map->Replaceable(frame)) {
+	    if (!secondChance || !map->Referenced(frame))
+		return frame;
+	    Freed(frame);			// move it to the end
+	    Allocated(frame);
+	}
+	frame = following;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// ClockPolicy::ClockPolicy
+// 	Initialize the clock, with the hand at frame 0.
+//----------------------------------------------------------------------
+
+ClockPolicy::ClockPolicy(CoreMap *frameMap, int frames)
+{
+    map = frameMap;
+    numFrames = frames;
+    hand = 0;
+}
+
+//----------------------------------------------------------------------
+// ClockPolicy::FindVictim
+// 	Advance the hand to the next replaceable frame whose use bit is
+//	clear, clearing the use bits it passes over.  Two trips around
+//	are enough, unless every frame is pinned.
+//----------------------------------------------------------------------
+
+int
+ClockPolicy::FindVictim()
+{
+    int frame;
+
+    for (int i = 0; i < 2 * numFrames; i++) {
+	frame = hand;
+	hand = (hand + 1) % numFrames;
+	if (map->Replaceable(frame) && !map->Referenced(frame))
+	    return frame;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AgingPolicy::AgingPolicy
+// 	Initialize the aging policy.
+//----------------------------------------------------------------------
+
+AgingPolicy::AgingPolicy(CoreMap *frameMap, int frames)
+{
+    map = frameMap;
+    numFrames = frames;
+    age = new unsigned int[numFrames];
+    for (int i = 0; i < numFrames; i++)
+	age[i] = 0;
+}
+
+AgingPolicy::~AgingPolicy()
+{
+    delete [] age;
+}
+
+//----------------------------------------------------------------------
+// AgingPolicy::Allocated
+// 	A page that was just brought in is about to be used, so start its
+//	counter off as if it had been used in the last period; otherwise
+//	it would be the first one replaced.
+//----------------------------------------------------------------------
+
+void
+AgingPolicy::Allocated(int frame)
+{
+    age[frame] = 1U << 31;
+}
+
+//----------------------------------------------------------------------
+// AgingPolicy::FindVictim
+// 	Age every frame in use, then return the replaceable frame with
+//	the smallest counter.  Page faults are the clock ticks that
+//	drive the aging, so pages age faster when memory is tight.
+//----------------------------------------------------------------------
+
+int
+AgingPolicy::FindVictim()
+{
+    int victim = -1;
+
+    for (int frame = 0; frame < numFrames; frame++) {
+	if (map->Frame(frame)->owner == NULL)
+	    continue;
+	age[frame] >>= 1;
+	if (map->Referenced(frame))
+	    age[frame] |= 1U << 31;
+	if (map->Replaceable(frame) && (victim == -1 || age[frame] < age[victim]))
+	    victim = frame;
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// WSClockPolicy::WSClockPolicy
+// 	Initialize WSClock, with the hand at frame 0.
+//----------------------------------------------------------------------
+
+WSClockPolicy::WSClockPolicy(CoreMap *frameMap, int frames)
+{
+    map = frameMap;
+    numFrames = frames;
+    hand = 0;
+    lastUse = new int[numFrames];
+}
+
+WSClockPolicy::~WSClockPolicy()
+{
+    delete [] lastUse;
+}
+
+//----------------------------------------------------------------------
+// WSClockPolicy::Allocated
+// 	A page that was just brought in is in the working set.
+//----------------------------------------------------------------------
+
+void
+WSClockPolicy::Allocated(int frame)
+{
+    lastUse[frame] = stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// WSClockPolicy::FindVictim
+// 	Sweep the hand around once, noting when each frame was last seen
+//	in use, and stop at the first clean frame that has been unused
+//	for longer than WorkingSetWindow.
+//
+//	Real WSClock schedules a write for each old dirty frame it passes
+//	and keeps going; our writes are synchronous, so instead we settle
+//	for the first old dirty frame if there is no old clean one.  If
+//	every frame is in a working set, fall back to plain clock: the
+//	first frame that had not been used, or failing that, the first
+//	frame the hand comes back to.
+//----------------------------------------------------------------------
+
+int
+WSClockPolicy::FindVictim()
+{
+    int now = stats->totalTicks;
+    int oldDirty = -1, unused = -1;
+    int frame;
+
+    for (int i = 0; i < numFrames; i++) {
+	frame = hand;
+	hand = (hand + 1) % numFrames;
+	if (!map->Replaceable(frame))
+	    continue;
+	if (map->Referenced(frame))
+	    lastUse[frame] = now;
+	else if (now - lastUse[frame] > WorkingSetWindow) {
+	    if (!map->IsDirty(frame))
+		return frame;
+	    if (oldDirty == -1)
+		oldDirty = frame;
+	} else if (unused == -1)
+	    unused = frame;
+    }
+    if (oldDirty != -1)
+	frame = oldDirty;
+    else if (unused != -1)
+	frame = unused;
+    else {				// everything was used; their use
+	for (int i = 0; i < numFrames; i++) {	// bits are clear now
+	    frame = hand;
+	    hand = (hand + 1) % numFrames;
+	    if (map->Replaceable(frame))
+		return frame;
+	}
+	return -1;
+    }
+    hand = (frame + 1) % numFrames;
+    return frame;
+}
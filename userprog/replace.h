@@ -0,0 +1,130 @@
+// replace.h
+//	Data structures for the page replacement policies: the rules the
+//	core map uses to choose which frame to take away from its page
+//	when memory is full.
+//
+//	All the policies are driven by the use and dirty bits that the
+//	machine sets in each TranslationEntry.  The policy is chosen when
+//	Nachos starts up (the -rp flag):
+//
+//	"fifo"    -- replace the page that came in first
+//	"second"  -- FIFO, but a page that has been used since it was
+//		     last looked at gets a second chance
+//	"clock"   -- second chance, with a hand sweeping over the frames
+//		     instead of a list (the default)
+//	"aging"   -- approximate LRU with a shift register per frame
+//	"wsclock" -- clock, but prefer clean pages that have fallen out
+//		     of their owner's working set
+
+#ifndef REPLACE_H
+#define REPLACE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class CoreMap;
+
+// The following class defines the interface every replacement policy
+// provides to the core map.  The core map tells the policy whenever a
+// frame starts or stops holding a page, and asks it for a victim
+// when no frame is free.
+
+class ReplacementPolicy {
+  public:
+    virtual ~ReplacementPolicy() {}
+
+    virtual const char *Name() = 0;	// what -rp calls the policy
+    virtual void Allocated(int frame) {}
+					// "frame" now holds a page
+    virtual void Freed(int frame) {}	// "frame" is free again
+    virtual int FindVictim() = 0;	// Return the # of the frame to
+					// replace, or -1 if every frame
+					// in use is pinned
+};
+
+// Make the policy named "name" for the frames of "frameMap", or return
+// NULL if there is no such policy.
+extern ReplacementPolicy *NewReplacementPolicy(const char *name,
+					CoreMap *frameMap, int frames);
+
+// First-in, first-out, with an optional second chance: frames in use
+// are kept on a circular list in the order they were allocated.
+
+class FIFOPolicy : public ReplacementPolicy {
+  public:
+    FIFOPolicy(CoreMap *frameMap, int frames, bool useSecondChance);
+    ~FIFOPolicy();
+
+    const char *Name() { return secondChance ? "second" : "fifo"; }
+    void Allocated(int frame);
+    void Freed(int frame);
+    int FindVictim();
+
+  private:
+    CoreMap *map;
+    int numFrames;
+    bool secondChance;		// move used frames to the end of the list
+    int *next, *prev;		// the frames in use, as a circular list
+    int oldest;			// first frame on that list, -1 if none
+};
+
+// The clock algorithm: a hand sweeps over all the frames, clearing use
+// bits, and stops at the first frame whose use bit was already clear.
+
+class ClockPolicy : public ReplacementPolicy {
+  public:
+    ClockPolicy(CoreMap *frameMap, int frames);
+
+    const char *Name() { return "clock"; }
+    int FindVictim();
+
+  private:
+    CoreMap *map;
+    int numFrames;
+    int hand;			// next frame to look at
+};
+
+// Aging, an approximation of LRU: every frame has a counter that is
+// shifted right on every page fault, with the use bit shifted in at
+// the top.  The frame with the smallest counter has gone unused the
+// longest.
+
+class AgingPolicy : public ReplacementPolicy {
+  public:
+    AgingPolicy(CoreMap *frameMap, int frames);
+    ~AgingPolicy();
+
+    const char *Name() { return "aging"; }
+    void Allocated(int frame);
+    int FindVictim();
+
+  private:
+    CoreMap *map;
+    int numFrames;
+    unsigned int *age;		// shift register for each frame
+};
+
+// WSClock: like clock, but a frame that was used within the last
+// WorkingSetWindow ticks is in its owner's working set and is left
+// alone, and clean frames are preferred over dirty ones, which would
+// have to be written back first.
+
+#define WorkingSetWindow	1000	// ticks
+
+class WSClockPolicy : public ReplacementPolicy {
+  public:
+    WSClockPolicy(CoreMap *frameMap, int frames);
+    ~WSClockPolicy();
+
+    const char *Name() { return "wsclock"; }
+    void Allocated(int frame);
+    int FindVictim();
+
+  private:
+    CoreMap *map;
+    int numFrames;
+    int hand;			// next frame to look at
+    int *lastUse;		// when each frame was last seen in use
+};
+
+#endif // REPLACE_H
@@ -0,0 +1,274 @@
+// swap.cc
+//	Routines to manage the swap area.
+
+#include "copyright.h"
+#include "system.h"
+#include "swap.h"
+#include <string.h>
+
+bool UseSwapDisk = FALSE;
+
+//----------------------------------------------------------------------
+// SwapDiskDone
+// 	Swap disk interrupt handler.  Need this to be a C routine, because
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+SwapDiskDone(int arg)
+{
+    ((SwapSpace *) arg)->DiskDone();
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::SwapSpace
+// 	Create the swap file, with room for "size" pages, and keep
+//	it open for as long as Nachos runs.  The file starts out empty,
+//	and grows as slots are written.
+//
+//	If UseSwapDisk is set, start up the swap disk instead.  It has a
+//	fixed size, so it may hold fewer than "size" pages.  If
+//	PoolBudgetPages is set, put a compressed pool in front of it.
+//----------------------------------------------------------------------
+
+SwapSpace::SwapSpace(int size)
+{
+    numSlots = size;
+    file = NULL;
+    disk = NULL;
+    diskLock = NULL;
+    diskDone = NULL;
+    sectorsPerSlot = divRoundUp(PageSize, SectorSize);
+    if (UseSwapDisk) {
+	numSlots = min(numSlots, NumSectors / sectorsPerSlot);
+	diskLock = new Lock("swap disk");
+	diskDone = new Semaphore("swap disk request", 0);
+	disk = new Disk(SwapDiskName, SwapDiskDone, (int) this);
+    } else {
+	fileSystem->Remove(SwapFileName);  // in case Nachos crashed last time
+	if (!fileSystem->Create(SwapFileName, 0)) {
+	    printf("Unable to create swap file %s\n", SwapFileName);
+	    ASSERT(FALSE);
+	}
+	file = fileSystem->Open(SwapFileName);
+	ASSERT(file != NULL);
+    }
+    slots = new BitMap(numSlots);
+    numUsers = new int[numSlots];
+    for (int i = 0; i < numSlots; i++)
+	numUsers[i] = 0;
+    pool = NULL;
+    if (PoolBudgetPages > 0)
+	pool = new CompressedPool(numSlots, PoolBudgetPages * PageSize);
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::~SwapSpace
+// 	Close the swap file and remove it; nothing in it outlives Nachos.
+//	The swap disk is just left as it is.
+//----------------------------------------------------------------------
+
+SwapSpace::~SwapSpace()
+{
+    if (pool != NULL)
+	delete pool;
+    if (disk != NULL) {
+	delete disk;
+	delete diskLock;
+	delete diskDone;
+    } else {
+	delete file;
+	fileSystem->Remove(SwapFileName);
+    }
+    delete slots;
+    delete [] numUsers;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::AllocateSlot
+// 	Find a free slot in the swap area, and mark it in use by one
+//	address space.
+//
+//	Returns -1 if every slot is taken.
+//----------------------------------------------------------------------
+
+int
+SwapSpace::AllocateSlot()
+{
+    int slot = slots->Find();
+
+    DEBUG('M', "Swap slot %d allocated\n", slot);
+    if (slot != -1)
+	numUsers[slot] = 1;
+    return slot;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::ShareSlot
+// 	Count one more address space using a slot that is in use.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::ShareSlot(int slot)
+{
+    ASSERT(slots->Test(slot));
+    numUsers[slot]++;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::FreeSlot
+// 	Count one fewer address space using a slot, and mark the slot
+//	as free again if that was the last one.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::FreeSlot(int slot)
+{
+    ASSERT(slots->Test(slot) && numUsers[slot] > 0);
+    if (--numUsers[slot] == 0) {
+	slots->Clear(slot);
+	if (pool != NULL)
+	    pool->Remove(slot);
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::ReadPages
+// 	Read the pages kept in the "count" slots starting with "slot"
+//	into the count * PageSize bytes at "into": the ones in the
+//	compressed pool from there, and each run of the others in one
+//	read.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::ReadPages(int slot, int count, char *into)
+{
+    int i = 0, j;
+
+    while (i < count) {
+	ASSERT(slots->Test(slot + i));
+	if (pool != NULL && pool->Load(slot + i, into + i * PageSize)) {
+	    stats->numPoolHits++;
+	    i++;
+	    continue;
+	}
+	for (j = i + 1; j < count; j++)
+	    if (pool != NULL && pool->Holds(slot + j))
+		break;
+	ReadSlots(slot + i, j - i, into + i * PageSize);
+	i = j;
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::WritePage
+// 	Write the PageSize bytes at "from" into "slot": into the
+//	compressed pool, if it will take them, making room in it if need
+//	be, or else into the swap file or disk.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::WritePage(int slot, char *from)
+{
+    ASSERT(slots->Test(slot));
+    if (pool != NULL && pool->Store(slot, from))
+	Spill();
+    else
+	WriteSlot(slot, from);
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::Spill
+// 	Write the least recently used pages in the compressed pool to
+//	their slots in the swap file or disk, and take them out of the
+//	pool, until it is within its budget again.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::Spill()
+{
+    char *page;
+    int slot;
+
+    if (!pool->OverBudget())
+	return;
+    page = new char[PageSize];
+    while (pool->OverBudget()) {
+	slot = pool->Oldest();
+	DEBUG('M', "Spilling swap slot %d from the pool\n", slot);
+	pool->Load(slot, page);
+	WriteSlot(slot, page);
+	pool->Remove(slot);
+	stats->numPoolSpills++;
+    }
+    delete [] page;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::ReadSlots
+// 	Read the "count" slots starting with "slot" from the swap file or
+//	disk into the count * PageSize bytes at "into", in one read.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::ReadSlots(int slot, int count, char *into)
+{
+    DEBUG('M', "Reading swap slots %d-%d\n", slot, slot + count - 1);
+    if (disk != NULL) {
+	diskLock->Acquire();
+	for (int i = 0; i < count; i++)
+	    TransferSlot(slot + i, into + i * PageSize, FALSE);
+	diskLock->Release();
+    } else
+	file->ReadAt(into, count * PageSize, slot * PageSize);
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::WriteSlot
+// 	Write the PageSize bytes at "from" into "slot" in the swap file
+//	or on the swap disk.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::WriteSlot(int slot, char *from)
+{
+    DEBUG('M', "Writing swap slot %d\n", slot);
+    if (disk != NULL) {
+	diskLock->Acquire();
+	TransferSlot(slot, from, TRUE);
+	diskLock->Release();
+    } else
+	file->WriteAt(from, PageSize, slot * PageSize);
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::TransferSlot
+// 	Read slot "slot" of the swap disk into the PageSize bytes at
+//	"data", or write them into it, one sector at a time, waiting for
+//	each to finish.  Whole sectors go straight to or from "data"; if
+//	pages are smaller than sectors, the one partial sector goes
+//	through a buffer.  diskLock must be held.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::TransferSlot(int slot, char *data, bool writing)
+{
+    char buffer[SectorSize];
+
+    for (int i = 0; i < sectorsPerSlot; i++) {
+	int sector = slot * sectorsPerSlot + i;
+	int offset = i * SectorSize;
+	bool whole = (PageSize - offset >= SectorSize);
+	char *at = whole ? data + offset : buffer;
+
+	if (writing) {
+	    if (!whole)
+		memcpy(buffer, data + offset, PageSize - offset);
+	    disk->WriteRequest(sector, at);
+	} else
+	    disk->ReadRequest(sector, at);
+	diskDone->P();
+	if (!writing && !whole)
+	    memcpy(data + offset, buffer, PageSize - offset);
+    }
+}
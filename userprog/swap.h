@@ -0,0 +1,89 @@
+// swap.h
+//	Data structures for the swap area, where pages that have been
+//	modified are kept while they are out of memory.
+//
+//	The swap area is a file, opened once when Nachos starts and kept
+//	open, divided into page-sized slots.  A slot is handed out the
+//	first time a page has to be written back, and stays with the page
+//	until its address space goes away.
+//
+//	Or, with -sd, the swap area is a disk of its own, separate from
+//	the one holding the file system, with its own arm and its own
+//	lock, so paging doesn't wait for file I/O, nor move the arm away
+//	from it.  There is no file system on it: slot # s is simply the
+//	sectors from s * (sectors per page) on, so the slots of pages
+//	written one after another are next to each other on the disk.
+//
+//	With -zp, pages written to swap are kept compressed in memory
+//	first, and only written to the swap file or disk when they have to
+//	make room for others (see cpool.h).
+//
+//	After a Fork, the child shares its parent's slots; each slot
+//	counts the address spaces using it, and is free again once none
+//	do.  A shared slot must not be written (see AddrSpace::ReserveSlot).
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "openfile.h"
+#include "bitmap.h"
+#include "disk.h"
+#include "synch.h"
+#include "cpool.h"
+
+#define SwapFileName	"SWAP_FILE"	// file holding the swap area
+#define SwapDiskName	"SWAP"		// or the UNIX file simulating the
+					// swap disk
+#define NumSwapSlots	1024		// # of pages it can hold
+extern bool UseSwapDisk;		// set with -sd
+
+// The following class defines the swap area.
+
+class SwapSpace {
+  public:
+    SwapSpace(int size);		// Create and open the swap file,
+					// or the swap disk
+    ~SwapSpace();			// Close and remove it
+
+    int AllocateSlot();			// Return the # of a free slot, or
+					// -1 if the swap area is full
+    void ShareSlot(int slot);		// One more address space uses it
+    void FreeSlot(int slot);		// One fewer does
+    int NumUsers(int slot) { return numUsers[slot]; }
+    int NumSlots() { return numSlots; }	// # of pages it can hold
+
+    void ReadPages(int slot, int count, char *into);
+					// Copy "count" slots, starting with
+					// "slot", into the pages at "into"
+    void WritePage(int slot, char *from);	// Copy the page at "from"
+						// into slot "slot"
+
+    void DiskDone() { diskDone->V(); }	// The swap disk has finished a
+					// request
+
+  private:
+    OpenFile *file;			// the swap area, if it is a file
+    Disk *disk;				// or the swap disk, if it is one
+    Lock *diskLock;			// one request at a time
+    Semaphore *diskDone;		// to wait for it to finish
+    int sectorsPerSlot;			// # of sectors each slot takes up
+    CompressedPool *pool;		// pages kept in memory, or NULL
+    BitMap *slots;			// which slots are in use
+    int *numUsers;			// # of address spaces using each
+    int numSlots;			// # of slots in the swap area
+
+    void ReadSlots(int slot, int count, char *into);
+    void WriteSlot(int slot, char *from);
+					// Read/write slots in the swap file
+					// or on the swap disk
+    void TransferSlot(int slot, char *data, bool writing);
+					// Read or write one slot on the
+					// swap disk
+    void Spill();			// Write the pool's least recently
+					// used pages to swap until it is
+					// within its budget
+};
+
+#endif // SWAP_H
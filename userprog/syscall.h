@@ -29,6 +29,9 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_Sbrk		11
+#define SC_Mmap		12
+#define SC_Munmap	13
 
 #ifndef IN_ASM
 //extern Machine* machine;
@@ -113,16 +116,46 @@ void Close(OpenFileId id);
  * threads to run within a user program. 
  */
 
-/* Fork a thread to run a procedure ("func") in the *same* address space 
- * as the current thread.
+/* Fork a process to run a procedure ("func") in a copy of the current
+ * thread's address space, and return its address space identifier, or
+ * -1 if there are too many processes already.  The copy starts out
+ * with the same memory and registers, and pages are only really copied
+ * when one of the two writes to them.  "func" must end by calling Exit.
  */
-void Fork(void (*func)());
+SpaceId Fork(void (*func)());
 
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 
  */
 void Yield();		
 
+/* Memory allocation: Sbrk.  The heap starts right after the program's
+ * data, and grows up towards the stack, which starts at the top of the
+ * address space and grows down on its own as the program touches it,
+ * up to a limit.
+ */
+
+/* Move the end of the heap by "increment" bytes (which may be negative),
+ * and return where it was, or -1 if the heap can't grow or shrink that
+ * far.  New heap memory reads as zeroes.
+ */
+int Sbrk(int increment);
+
+/* Map the first "length" bytes of the open file "id" into memory, and
+ * return the address they start at, or -1 if there is no room.  Reading
+ * and writing that memory reads and writes the file, with no Read or
+ * Write calls; changes reach the file by the time Munmap or Exit
+ * returns.  The file doesn't grow: memory past its end reads as zeroes,
+ * and what is stored there is lost.  A process made by Fork doesn't
+ * have the files its parent mapped.
+ */
+int Mmap(OpenFileId id, int length);
+
+/* Unmap the file mapped at "addr", which Mmap returned.  Returns 0, or
+ * -1 if no file is mapped there.
+ */
+int Munmap(int addr);
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */